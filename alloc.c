@@ -0,0 +1,242 @@
+/*****************************************************
+ * CG Solver (HPC Software Lab)
+ *
+ * Parallel Programming Models for Applications in the 
+ * Area of High-Performance Computation
+ *====================================================
+ * Aligned and huge page allocation of large arrays
+ *****************************************************/
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32) || defined(_WIN64)
+# include <malloc.h>
+#else
+# include <sys/mman.h>
+#endif
+
+#include "def.h"
+#include "alloc.h"
+
+/* Every allocation of allocLarge() is recorded, so freeLarge()
+ * knows how it was obtained and hugePageUsage() can check which
+ * parts are really backed by huge pages. Solvers of the library may
+ * be set up and destroyed in several threads at once, so the list
+ * is only used in the critical section "allocations". */
+struct Allocation {
+	void* ptr;
+	size_t bytes;
+	enum HugePages pages;
+	struct Allocation* next;
+};
+
+static struct Allocation* allocations = NULL;
+
+/* Allocate bytes of memory aligned to ALIGNMENT. The program
+ * exits if the memory can not be allocated. */
+void* allocAligned(size_t bytes){
+	void* ptr;
+
+#if defined(_WIN32) || defined(_WIN64)
+	ptr = _aligned_malloc(bytes, ALIGNMENT);
+#else
+	if (posix_memalign(&ptr, ALIGNMENT, bytes) != 0)
+		ptr = NULL;
+#endif
+
+	if (ptr == NULL) {
+		puts("Out of memory!");
+		fatalError();
+	}
+
+	return ptr;
+}
+
+/* Free memory allocated with allocAligned() */
+void freeAligned(void* ptr){
+#if defined(_WIN32) || defined(_WIN64)
+	_aligned_free(ptr);
+#else
+	free(ptr);
+#endif
+}
+
+#if !defined(_WIN32) && !defined(_WIN64)
+/* Map bytes (a multiple of HUGE_PAGE_SIZE) of anonymous memory
+ * aligned to HUGE_PAGE_SIZE, so that the kernel can back the
+ * whole range with transparent huge pages. */
+static void* mapAligned(size_t bytes){
+	char *ptr, *aligned;
+	size_t head, tail;
+
+	ptr = (char*)mmap(NULL, bytes + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+	    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (ptr == MAP_FAILED)
+		return NULL;
+
+	/* Unmap the unaligned head and the rest at the tail */
+	aligned = (char*)(((size_t)ptr + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1));
+	head = aligned - ptr;
+	tail = HUGE_PAGE_SIZE - head;
+	if (head > 0)
+		munmap(ptr, head);
+	if (tail > 0)
+		munmap(aligned + bytes, tail);
+
+	return aligned;
+}
+#endif
+
+/* Allocate a large array of bytes. Depending on CG_HUGEPAGES it is
+ * backed by transparent huge pages (madvise), by reserved huge
+ * pages of hugetlbfs, or by normal pages. If no reserved huge pages
+ * are available, transparent huge pages are used instead. The
+ * memory is always aligned to at least ALIGNMENT and must be freed
+ * with freeLarge(). */
+void* allocLarge(size_t bytes){
+	struct Allocation* a;
+	size_t rounded;
+
+	if ((a = (struct Allocation*)malloc(sizeof(struct Allocation))) == NULL) {
+		puts("Out of memory!");
+		fatalError();
+	}
+
+	a->ptr = NULL;
+	a->pages = config.hugePages;
+
+	/* Small arrays do not profit from huge pages */
+	if (bytes < HUGE_PAGE_MIN)
+		a->pages = HUGEPAGES_NONE;
+
+	rounded = (bytes + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+
+#if !defined(_WIN32) && !defined(_WIN64)
+# ifdef MAP_HUGETLB
+	if (a->pages == HUGEPAGES_HUGETLB) {
+		a->ptr = mmap(NULL, rounded, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (a->ptr == MAP_FAILED) {
+			a->ptr = NULL;
+			a->pages = HUGEPAGES_THP;
+		}
+	}
+# else
+	if (a->pages == HUGEPAGES_HUGETLB)
+		a->pages = HUGEPAGES_THP;
+# endif
+
+	if (a->pages == HUGEPAGES_THP) {
+		if ((a->ptr = mapAligned(rounded)) == NULL) {
+			puts("Out of memory!");
+			fatalError();
+		}
+# ifdef MADV_HUGEPAGE
+		madvise(a->ptr, rounded, MADV_HUGEPAGE);
+# endif
+	}
+#else
+	a->pages = HUGEPAGES_NONE;
+#endif
+
+	if (a->pages == HUGEPAGES_NONE) {
+		a->ptr = allocAligned(bytes);
+		a->bytes = bytes;
+	} else {
+		a->bytes = rounded;
+	}
+
+#pragma omp critical (allocations)
+	{
+		a->next = allocations;
+		allocations = a;
+	}
+
+	return a->ptr;
+}
+
+/* Free memory allocated with allocLarge() */
+void freeLarge(void* ptr){
+	struct Allocation **prev, *a;
+
+	if (ptr == NULL)
+		return;
+
+#pragma omp critical (allocations)
+	{
+		for (prev = &allocations; (a = *prev) != NULL; prev = &a->next) {
+			if (a->ptr == ptr)
+				break;
+		}
+		if (a != NULL)
+			*prev = a->next;
+	}
+
+	if (a == NULL) {
+		puts("ERROR: freeLarge() called for unknown pointer!");
+		fatalError();
+	}
+
+#if !defined(_WIN32) && !defined(_WIN64)
+	if (a->pages != HUGEPAGES_NONE)
+		munmap(a->ptr, a->bytes);
+	else
+#endif
+		freeAligned(a->ptr);
+
+	free(a);
+}
+
+/* Return the bytes of all live allocLarge() arrays in total and
+ * the part of it which is backed by huge pages. Transparent huge
+ * pages are only assigned when the memory is touched, so call this
+ * after the arrays were initialized. The kernel reports them per
+ * mapping in /proc/self/smaps. A mapping may hold several arrays,
+ * as the kernel merges adjacent ones, so every array gets the part
+ * of the huge pages of the mapping which it covers. */
+void hugePageUsage(size_t* total, size_t* huge){
+	struct Allocation* a;
+	size_t start = 0, end = 0, kb, lo, hi;
+	char line[256];
+	FILE* fp;
+
+	*total = 0;
+	*huge = 0;
+
+	fp = fopen("/proc/self/smaps", "r");
+
+#pragma omp critical (allocations)
+	{
+		for (a = allocations; a != NULL; a = a->next) {
+			*total += a->bytes;
+			if (a->pages == HUGEPAGES_HUGETLB)
+				*huge += a->bytes;
+		}
+
+		while (fp != NULL && fgets(line, sizeof(line), fp) != NULL) {
+			if (sscanf(line, "%zx-%zx ", &lo, &hi) == 2) {
+				start = lo;
+				end = hi;
+			} else if (sscanf(line, "AnonHugePages: %zu kB", &kb) == 1 && kb > 0) {
+				for (a = allocations; a != NULL; a = a->next) {
+					if (a->pages != HUGEPAGES_THP)
+						continue;
+
+					/* Count the huge pages of the mapping in
+					 * proportion to its overlap with the array */
+					lo = ((size_t)a->ptr > start) ? (size_t)a->ptr : start;
+					hi = ((size_t)a->ptr + a->bytes < end) ? (size_t)a->ptr + a->bytes : end;
+					if (lo < hi)
+						*huge += (size_t)((double)kb * 1024 * (hi - lo) / (end - start));
+				}
+			}
+		}
+	}
+
+	if (fp != NULL)
+		fclose(fp);
+}
@@ -0,0 +1,38 @@
+/*****************************************************
+ * CG Solver (HPC Software Lab)
+ *
+ * Parallel Programming Models for Applications in the 
+ * Area of High-Performance Computation
+ *====================================================
+ * Aligned and huge page allocation of large arrays
+ *****************************************************/
+
+
+
+#ifndef __ALLOC_H__
+#define __ALLOC_H__
+
+#include <stddef.h>
+
+/* Alignment of all vectors in bytes (one cache line) */
+#define ALIGNMENT 64
+
+/* Size of a huge page in bytes (2 MiB) */
+#define HUGE_PAGE_SIZE (2UL * 1024 * 1024)
+
+/* Arrays smaller than this are not worth a huge page */
+#define HUGE_PAGE_MIN (HUGE_PAGE_SIZE / 2)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+void* allocAligned(size_t bytes);
+void freeAligned(void* ptr);
+void* allocLarge(size_t bytes);
+void freeLarge(void* ptr);
+void hugePageUsage(size_t* total, size_t* huge);
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,859 @@
+/*****************************************************
+ * CG Solver (HPC Software Lab)
+ *
+ * Parallel Programming Models for Applications in the 
+ * Area of High-Performance Computation
+ *====================================================
+ * Smoothed aggregation multigrid preconditioner
+ *****************************************************/
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#ifdef _OPENMP
+# include <omp.h>
+#else
+# define omp_get_thread_num() 0
+#endif
+
+#include "amg.h"
+#include "alloc.h"
+#include "io.h"
+
+/* Levels are added until a level has at most this many rows */
+#define AMG_COARSE_SIZE 1000
+
+/* Coarsest levels up to this size are solved with a dense Cholesky
+ * factorization, larger ones (if the coarsening stalls) with CG */
+#define AMG_DIRECT_MAX 2000
+#define AMG_COARSE_TOL 1e-8
+
+#define AMG_MAX_LEVELS 10
+
+/* Stop coarsening if a level keeps more than this part of the rows */
+#define AMG_MIN_COARSENING 0.8
+
+/* Strength threshold of the finest level, halved on every level */
+#define AMG_THETA 0.08
+
+/* Jacobi sweeps before and after the coarse grid correction */
+#define AMG_SWEEPS 1
+
+/* Degree of the Chebyshev smoother, which damps the eigenvalues of
+ * D^-1 * A in [rho / AMG_CHEBYSHEV_RATIO, rho] with the Gershgorin
+ * bound rho */
+#define AMG_CHEBYSHEV_DEGREE 2
+#define AMG_CHEBYSHEV_RATIO 30.0
+
+/* Coarse levels are added while the nonzeros of all levels stay
+ * within this multiple of the nonzeros of the matrix (operator
+ * complexity) */
+#define AMG_COMPLEXITY 3.0
+
+/* Sparse matrix in compressed row storage, only used while the
+ * hierarchy is built and for the transfer operators */
+struct CSR {
+	int rows, cols;
+	offsetType* ptr;
+	int* col;
+	floatType* val;
+};
+
+/* One level of the hierarchy. A is the matrix of the level in the
+ * storage format of CG_FORMAT (the fine one is the operator of the
+ * solver), the ELLPACK-R arrays belong to the coarse levels. P
+ * interpolates from the next level, R = P^T restricts to it. b, x
+ * and res are the vectors of the cycle on this level, d is the
+ * update of the Chebyshev smoother. */
+struct AMGLevel {
+	int n;
+	struct Operator* A;
+	floatType* data;
+	int *indices, *length;
+	floatType* invDiag;
+	floatType omega, rho;
+	struct CSR P, R;
+	floatType *b, *x, *res, *d;
+};
+
+struct AMGState {
+	int count;
+	struct AMGLevel levels[AMG_MAX_LEVELS];
+	/* Dense Cholesky factor of the coarsest level, or NULL */
+	floatType* cholesky;
+	struct Workspace* coarseWs;
+};
+
+
+/* Allocate the row pointers of a rows x cols matrix */
+static void initCSR(struct CSR* M, const int rows, const int cols){
+	M->rows = rows;
+	M->cols = cols;
+	M->ptr = (offsetType*)calloc(rows + 1, sizeof(offsetType));
+	M->col = NULL;
+	M->val = NULL;
+	if (M->ptr == NULL) {
+		puts("Out of memory!");
+		fatalError();
+	}
+}
+
+/* Turn the row lengths in ptr[1..rows] into offsets and allocate
+ * the entries */
+static void finishCSR(struct CSR* M){
+	int i;
+
+	for (i = 0; i < M->rows; i++)
+		M->ptr[i + 1] += M->ptr[i];
+	M->col = (int*)malloc(sizeof(int) * (M->ptr[M->rows] + 1));
+	M->val = (floatType*)malloc(sizeof(floatType) * (M->ptr[M->rows] + 1));
+	if (M->col == NULL || M->val == NULL) {
+		puts("Out of memory!");
+		fatalError();
+	}
+}
+
+static void freeCSR(struct CSR* M){
+	free(M->ptr);
+	free(M->col);
+	free(M->val);
+}
+
+/* Copy the entries of the ELLPACK-R matrix without the padding */
+static void ellToCSR(const int n, const floatType* data, const int* indices, const int* length, struct CSR* M){
+	int i, j;
+	offsetType k;
+
+	initCSR(M, n, n);
+	for (i = 0; i < n; i++)
+		M->ptr[i + 1] = length[i];
+	finishCSR(M);
+
+#pragma omp parallel for num_threads(threads) private(i, j, k)
+	for (i = 0; i < n; i++) {
+		for (j = 0; j < length[i]; j++) {
+			k = (offsetType)j * n + i;
+			M->col[M->ptr[i] + j] = indices[k];
+			M->val[M->ptr[i] + j] = data[k];
+		}
+	}
+}
+
+/* Store the square matrix M in ELLPACK-R format, with the same
+ * padding as cooToEll() */
+static void csrToEll(const struct CSR* M, int* maxNNZ, floatType** data, int** indices, int** length){
+	const int n = M->rows;
+	int i, j, width = 0;
+	offsetType k;
+
+	for (i = 0; i < n; i++)
+		if (M->ptr[i + 1] - M->ptr[i] > width)
+			width = (int)(M->ptr[i + 1] - M->ptr[i]);
+
+	*maxNNZ = width;
+	*data = (floatType*)allocLarge(sizeof(floatType) * width * n);
+	*indices = (int*)allocLarge(sizeof(int) * width * n);
+	*length = (int*)allocLarge(sizeof(int) * n);
+
+#pragma omp parallel for num_threads(threads) private(i, j, k)
+	for (i = 0; i < n; i++) {
+		(*length)[i] = (int)(M->ptr[i + 1] - M->ptr[i]);
+		for (j = 0; j < width; j++) {
+			k = (offsetType)j * n + i;
+			if (j < (*length)[i]) {
+				(*data)[k] = M->val[M->ptr[i] + j];
+				(*indices)[k] = M->col[M->ptr[i] + j];
+			} else {
+				(*data)[k] = 0.0;
+				(*indices)[k] = 0;
+			}
+		}
+	}
+}
+
+/* T <- M^T, the columns of every row of T are in ascending order */
+static void transposeCSR(const struct CSR* M, struct CSR* T){
+	offsetType* next;
+	offsetType k;
+	int i;
+
+	initCSR(T, M->cols, M->rows);
+	for (k = 0; k < M->ptr[M->rows]; k++)
+		T->ptr[M->col[k] + 1]++;
+	finishCSR(T);
+
+	next = (offsetType*)malloc(sizeof(offsetType) * (T->rows + 1));
+	if (next == NULL) {
+		puts("Out of memory!");
+		fatalError();
+	}
+	for (i = 0; i < T->rows; i++)
+		next[i] = T->ptr[i];
+	for (i = 0; i < M->rows; i++) {
+		for (k = M->ptr[i]; k < M->ptr[i + 1]; k++) {
+			T->col[next[M->col[k]]] = i;
+			T->val[next[M->col[k]]++] = M->val[k];
+		}
+	}
+	free(next);
+}
+
+/* C <- A * B, parallel over the rows of A. A first pass counts the
+ * entries of every row of C, the second one computes them. Every
+ * thread marks the columns it has seen in a row in its own part of
+ * marker, which is allocated outside of the parallel regions. */
+static void multiplyCSR(const struct CSR* A, const struct CSR* B, struct CSR* C){
+	offsetType* marker;
+
+	initCSR(C, A->rows, B->cols);
+	marker = (offsetType*)malloc(sizeof(offsetType) * threads * (size_t)B->cols);
+	if (marker == NULL && B->cols > 0) {
+		puts("Out of memory!");
+		fatalError();
+	}
+
+#pragma omp parallel num_threads(threads)
+	{
+		offsetType* seen = marker + (size_t)omp_get_thread_num() * B->cols;
+		offsetType k, l, count;
+		int i, c;
+
+		for (c = 0; c < B->cols; c++)
+			seen[c] = -1;
+#pragma omp for
+		for (i = 0; i < A->rows; i++) {
+			count = 0;
+			for (k = A->ptr[i]; k < A->ptr[i + 1]; k++) {
+				for (l = B->ptr[A->col[k]]; l < B->ptr[A->col[k] + 1]; l++) {
+					if (seen[B->col[l]] != i) {
+						seen[B->col[l]] = i;
+						count++;
+					}
+				}
+			}
+			C->ptr[i + 1] = count;
+		}
+	}
+
+	finishCSR(C);
+
+#pragma omp parallel num_threads(threads)
+	{
+		offsetType* seen = marker + (size_t)omp_get_thread_num() * B->cols;
+		offsetType k, l, pos;
+		int i, c;
+
+		for (c = 0; c < B->cols; c++)
+			seen[c] = -1;
+#pragma omp for
+		for (i = 0; i < A->rows; i++) {
+			pos = C->ptr[i];
+			for (k = A->ptr[i]; k < A->ptr[i + 1]; k++) {
+				for (l = B->ptr[A->col[k]]; l < B->ptr[A->col[k] + 1]; l++) {
+					c = B->col[l];
+					if (seen[c] < C->ptr[i]) {
+						seen[c] = pos;
+						C->col[pos] = c;
+						C->val[pos++] = A->val[k] * B->val[l];
+					} else {
+						C->val[seen[c]] += A->val[k] * B->val[l];
+					}
+				}
+			}
+		}
+	}
+
+	free(marker);
+}
+
+/* y <- M * x, or y <- y + M * x if add is set */
+static void applyCSR(const struct CSR* M, const floatType* x, floatType* y, const int add){
+	offsetType k;
+	floatType sum;
+	int i;
+
+#pragma omp parallel for num_threads(threads) private(i, k, sum)
+	for (i = 0; i < M->rows; i++) {
+		sum = add ? y[i] : 0.0;
+		for (k = M->ptr[i]; k < M->ptr[i + 1]; k++)
+			sum += M->val[k] * x[M->col[k]];
+		y[i] = sum;
+	}
+}
+
+
+/* Store the inverted diagonal of M in invDiag and return the
+ * Gershgorin bound max_i sum_j |a_ij / a_ii| of the spectral
+ * radius of D^-1 * M */
+static floatType invertDiagonal(const struct CSR* M, floatType* invDiag){
+	floatType rho = 0.0, sum, diag;
+	offsetType k;
+	int i, missing = -1;
+
+#pragma omp parallel for num_threads(threads) private(i, k, sum, diag) reduction(max:rho, missing)
+	for (i = 0; i < M->rows; i++) {
+		diag = 0.0;
+		sum = 0.0;
+		for (k = M->ptr[i]; k < M->ptr[i + 1]; k++) {
+			if (M->col[k] == i)
+				diag += M->val[k];
+			sum += fabs(M->val[k]);
+		}
+		if (diag == 0.0) {
+			missing = i;
+			continue;
+		}
+		invDiag[i] = 1.0 / diag;
+		if (sum / fabs(diag) > rho)
+			rho = sum / fabs(diag);
+	}
+
+	if (missing >= 0) {
+		printf("ERROR: Row %d has no diagonal entry, it cannot be preconditioned!\n", missing);
+		fatalError();
+	}
+	return rho;
+}
+
+/* Pseudo random priority of row i for the independent set */
+static unsigned int priority(unsigned int i){
+	i ^= i >> 16;
+	i *= 0x7feb352dU;
+	i ^= i >> 15;
+	i *= 0x846ca68bU;
+	i ^= i >> 16;
+	return i & 0x7fffffffU;
+}
+
+/* States of the rows in the independent set, the larger the better */
+#define MIS_OUT 0ULL
+#define MIS_UNDECIDED 1ULL
+#define MIS_IN 2ULL
+#define MIS_KEY(state, i) (((state) << 62) | ((unsigned long long)priority(i) << 31) | (unsigned long long)(i))
+
+/* Group the rows into aggregates of strongly connected rows, with
+ * |a_ij| >= theta * sqrt(|a_ii * a_jj|), in parallel (Bell, Dalton
+ * and Olson, Exposing fine-grained parallelism in algebraic
+ * multigrid methods, 2012):
+ *  1. The roots are a maximal independent set of distance 2 in the
+ *     graph of the strong connections. In every round an undecided
+ *     row joins it if it has the largest key within distance 2,
+ *     and leaves it if a row within distance 2 has joined.
+ *  2. Every root forms an aggregate with its strong neighbors.
+ *  3. The remaining rows join an aggregate of a strong neighbor.
+ * The keys are pseudo random, so the result does not depend on the
+ * number of threads. agg[i] is set to the aggregate of row i, the
+ * number of aggregates is returned. */
+static int aggregate(const struct CSR* M, const floatType* invDiag, const floatType theta, int* agg){
+	const int n = M->rows;
+	unsigned long long *key, *t1, *t2, max;
+	char* strong;
+	int i, j, count, undecided;
+	offsetType k;
+
+	key = (unsigned long long*)malloc(sizeof(unsigned long long) * n);
+	t1 = (unsigned long long*)malloc(sizeof(unsigned long long) * n);
+	t2 = (unsigned long long*)malloc(sizeof(unsigned long long) * n);
+	strong = (char*)malloc(M->ptr[n] + 1);
+	if (key == NULL || t1 == NULL || t2 == NULL || strong == NULL) {
+		puts("Out of memory!");
+		fatalError();
+	}
+
+#pragma omp parallel for num_threads(threads) private(i, k)
+	for (i = 0; i < n; i++) {
+		for (k = M->ptr[i]; k < M->ptr[i + 1]; k++)
+			strong[k] = M->col[k] != i &&
+			    fabs(M->val[k]) >= theta * sqrt(fabs(1.0 / (invDiag[i] * invDiag[M->col[k]])));
+		key[i] = MIS_KEY(MIS_UNDECIDED, i);
+	}
+
+	/* 1. Independent set of distance 2 */
+	do {
+#pragma omp parallel for num_threads(threads) private(i, k, max)
+		for (i = 0; i < n; i++) {
+			max = key[i];
+			for (k = M->ptr[i]; k < M->ptr[i + 1]; k++)
+				if (strong[k] && key[M->col[k]] > max)
+					max = key[M->col[k]];
+			t1[i] = max;
+		}
+		undecided = 0;
+#pragma omp parallel for num_threads(threads) private(i, k, max) reduction(+:undecided)
+		for (i = 0; i < n; i++) {
+			max = t1[i];
+			for (k = M->ptr[i]; k < M->ptr[i + 1]; k++)
+				if (strong[k] && t1[M->col[k]] > max)
+					max = t1[M->col[k]];
+			t2[i] = max;
+			if (key[i] >> 62 != MIS_UNDECIDED)
+				continue;
+			if (max == key[i])
+				t2[i] = MIS_KEY(MIS_IN, i);
+			else if (max >> 62 == MIS_IN)
+				t2[i] = MIS_KEY(MIS_OUT, i);
+			else
+				undecided++;
+		}
+#pragma omp parallel for num_threads(threads) private(i)
+		for (i = 0; i < n; i++) {
+			if (key[i] >> 62 == MIS_UNDECIDED)
+				key[i] = t2[i];
+		}
+	} while (undecided > 0);
+
+	/* 2. Aggregates around the roots */
+	count = 0;
+	for (i = 0; i < n; i++)
+		agg[i] = (key[i] >> 62 == MIS_IN) ? count++ : -1;
+#pragma omp parallel for num_threads(threads) private(i, k)
+	for (i = 0; i < n; i++) {
+		t1[i] = agg[i];
+		if (agg[i] >= 0)
+			continue;
+		for (k = M->ptr[i]; k < M->ptr[i + 1]; k++) {
+			if (strong[k] && key[M->col[k]] >> 62 == MIS_IN) {
+				t1[i] = agg[M->col[k]];
+				break;
+			}
+		}
+	}
+
+	/* 3. Join a neighbor aggregated in step 2. Rows which are still
+	 * left, which only happens without symmetric strong
+	 * connections, become aggregates of their own. */
+#pragma omp parallel for num_threads(threads) private(i, j, k)
+	for (i = 0; i < n; i++) {
+		agg[i] = (int)(long long)t1[i];
+		if (agg[i] >= 0)
+			continue;
+		for (k = M->ptr[i]; k < M->ptr[i + 1]; k++) {
+			j = M->col[k];
+			if (strong[k] && (long long)t1[j] >= 0) {
+				agg[i] = (int)(long long)t1[j];
+				break;
+			}
+		}
+	}
+	for (i = 0; i < n; i++)
+		if (agg[i] < 0)
+			agg[i] = count++;
+
+	free(key);
+	free(t1);
+	free(t2);
+	free(strong);
+	return count;
+}
+
+/* The smoothed prolongator P = (I - omega * D^-1 * M) * P0 of the
+ * aggregates with omega = 4/3 / rho(D^-1 * M), or P0 itself if
+ * smoothed is not set. P0 interpolates the constant vector: row i
+ * has the entry 1/sqrt(|aggregate|) in the column of its
+ * aggregate. */
+static void smoothedProlongator(const struct CSR* M, const floatType* invDiag, const floatType rho, const int* agg, const int aggCount, const int smoothed, struct CSR* P){
+	const floatType omega = 4.0 / 3.0 / rho;
+	struct CSR S, P0;
+	floatType* scale;
+	offsetType k;
+	int i;
+
+	scale = (floatType*)calloc(aggCount, sizeof(floatType));
+	if (scale == NULL) {
+		puts("Out of memory!");
+		fatalError();
+	}
+	for (i = 0; i < M->rows; i++)
+		scale[agg[i]] += 1.0;
+	for (i = 0; i < aggCount; i++)
+		scale[i] = 1.0 / sqrt(scale[i]);
+
+	initCSR(&P0, M->rows, aggCount);
+	for (i = 0; i < M->rows; i++)
+		P0.ptr[i + 1] = 1;
+	finishCSR(&P0);
+	for (i = 0; i < M->rows; i++) {
+		P0.col[i] = agg[i];
+		P0.val[i] = scale[agg[i]];
+	}
+	if (!smoothed) {
+		*P = P0;
+		free(scale);
+		return;
+	}
+
+	/* S = -omega * D^-1 * M, the identity is added to S * P0 */
+	initCSR(&S, M->rows, M->cols);
+	for (i = 0; i < M->rows; i++)
+		S.ptr[i + 1] = M->ptr[i + 1] - M->ptr[i];
+	finishCSR(&S);
+#pragma omp parallel for num_threads(threads) private(i, k)
+	for (i = 0; i < M->rows; i++) {
+		for (k = M->ptr[i]; k < M->ptr[i + 1]; k++) {
+			S.col[k] = M->col[k];
+			S.val[k] = -omega * invDiag[i] * M->val[k];
+		}
+	}
+
+	multiplyCSR(&S, &P0, P);
+
+	/* Row i of S * P0 has the column agg[i], as M has a diagonal */
+#pragma omp parallel for num_threads(threads) private(i, k)
+	for (i = 0; i < M->rows; i++) {
+		for (k = P->ptr[i]; k < P->ptr[i + 1]; k++) {
+			if (P->col[k] == agg[i]) {
+				P->val[k] += scale[agg[i]];
+				break;
+			}
+		}
+	}
+
+	freeCSR(&S);
+	freeCSR(&P0);
+	free(scale);
+}
+
+/* Factorize the dense matrix of M as L * L^T, L is stored row by
+ * row in the lower triangle */
+static floatType* factorize(const struct CSR* M){
+	const int n = M->rows;
+	floatType* L;
+	floatType sum;
+	offsetType k;
+	int i, j, l;
+
+	L = (floatType*)calloc((size_t)n * n, sizeof(floatType));
+	if (L == NULL) {
+		puts("Out of memory!");
+		fatalError();
+	}
+	for (i = 0; i < n; i++)
+		for (k = M->ptr[i]; k < M->ptr[i + 1]; k++)
+			L[(size_t)i * n + M->col[k]] += M->val[k];
+
+	for (j = 0; j < n; j++) {
+		sum = L[(size_t)j * n + j];
+		for (l = 0; l < j; l++)
+			sum -= L[(size_t)j * n + l] * L[(size_t)j * n + l];
+		if (sum <= 0.0) {
+			printf("ERROR: The coarse matrix of AMG is not positive definite!\n");
+			fatalError();
+		}
+		L[(size_t)j * n + j] = sqrt(sum);
+#pragma omp parallel for num_threads(threads) private(i, l, sum)
+		for (i = j + 1; i < n; i++) {
+			sum = L[(size_t)i * n + j];
+			for (l = 0; l < j; l++)
+				sum -= L[(size_t)i * n + l] * L[(size_t)j * n + l];
+			L[(size_t)i * n + j] = sum / L[(size_t)j * n + j];
+		}
+	}
+	return L;
+}
+
+/* x <- A^-1 * b on the coarsest level */
+static void coarseSolve(const struct AMGState* s, const floatType* b, floatType* x){
+	const struct AMGLevel* L = &s->levels[s->count - 1];
+	const int n = L->n;
+	const floatType* c = s->cholesky;
+	struct SolverConfig sc;
+	floatType sum;
+	int i, l;
+
+	if (c != NULL) {
+		/* Forward and backward substitution */
+		for (i = 0; i < n; i++) {
+			sum = b[i];
+			for (l = 0; l < i; l++)
+				sum -= c[(size_t)i * n + l] * x[l];
+			x[i] = sum / c[(size_t)i * n + i];
+		}
+		for (i = n - 1; i >= 0; i--) {
+			sum = x[i];
+			for (l = i + 1; l < n; l++)
+				sum -= c[(size_t)l * n + i] * x[l];
+			x[i] = sum / c[(size_t)i * n + i];
+		}
+		return;
+	}
+
+	for (i = 0; i < n; i++)
+		x[i] = 0.0;
+	sc.maxIter = n;
+	sc.tolerance = AMG_COARSE_TOL;
+	sc.verbose = 0;
+	sc.checkpointFile = NULL;
+	sc.checkpointInterval = 0;
+	sc.restartFile = NULL;
+	sc.alphas = sc.betas = NULL;
+	cg(L->A, NULL, b, x, &sc, s->coarseWs);
+}
+
+/* One Jacobi sweep x <- x + omega * D^-1 * (b - A*x) */
+static void jacobiSweep(const struct AMGLevel* L, const floatType* b, floatType* x){
+	int i;
+
+	L->A->apply(L->A, x, L->res);
+#pragma omp parallel for num_threads(threads) private(i)
+	for (i = 0; i < L->n; i++) {
+		x[i] += L->omega * L->invDiag[i] * (b[i] - L->res[i]);
+	}
+}
+
+/* Chebyshev smoothing of A*x = b with the polynomial of degree
+ * AMG_CHEBYSHEV_DEGREE in D^-1 * A, see applyChebyshev() in
+ * chebyshev.c. With zero set, x is 0 on entry and the first
+ * residual needs no matvec. */
+static void chebyshevSmooth(const struct AMGLevel* L, const floatType* b, floatType* x, const int zero){
+	const floatType lmax = L->rho;
+	const floatType lmin = L->rho / AMG_CHEBYSHEV_RATIO;
+	const floatType theta = 0.5 * (lmax + lmin);
+	const floatType delta = 0.5 * (lmax - lmin);
+	const floatType sigma = theta / delta;
+	floatType rho, rhoNew, c1, c2;
+	int i, k;
+
+	if (!zero)
+		L->A->apply(L->A, x, L->res);
+#pragma omp parallel for num_threads(threads) private(i)
+	for (i = 0; i < L->n; i++) {
+		L->d[i] = L->invDiag[i] * (b[i] - (zero ? 0.0 : L->res[i])) / theta;
+		x[i] = (zero ? 0.0 : x[i]) + L->d[i];
+	}
+
+	rho = 1.0 / sigma;
+	for (k = 1; k <= AMG_CHEBYSHEV_DEGREE; k++) {
+		L->A->apply(L->A, x, L->res);
+		rhoNew = 1.0 / (2.0 * sigma - rho);
+		c1 = rhoNew * rho;
+		c2 = 2.0 * rhoNew / delta;
+#pragma omp parallel for num_threads(threads) private(i)
+		for (i = 0; i < L->n; i++) {
+			L->d[i] = c1 * L->d[i] + c2 * L->invDiag[i] * (b[i] - L->res[i]);
+			x[i] += L->d[i];
+		}
+		rho = rhoNew;
+	}
+}
+
+/* Smoothing with the CG_SMOOTHER of A*x = b on level L, x is 0 on
+ * entry if zero is set */
+static void smooth(const struct AMGLevel* L, const floatType* b, floatType* x, const int zero){
+	int i, sweep = 0;
+
+	if (config.smoother == SMOOTHER_CHEBYSHEV) {
+		chebyshevSmooth(L, b, x, zero);
+		return;
+	}
+
+	/* The first sweep from x = 0 needs no matvec */
+	if (zero) {
+#pragma omp parallel for num_threads(threads) private(i)
+		for (i = 0; i < L->n; i++) {
+			x[i] = L->omega * L->invDiag[i] * b[i];
+		}
+		sweep = 1;
+	}
+	for (; sweep < AMG_SWEEPS; sweep++)
+		jacobiSweep(L, b, x);
+}
+
+/* x <- V-cycle for A*x = b on level l, starting from x = 0. The
+ * same smoothing before and after the coarse grid correction keeps
+ * the cycle symmetric. */
+static void cycle(const struct AMGState* s, const int l, const floatType* b, floatType* x){
+	const struct AMGLevel* L = &s->levels[l];
+	const struct AMGLevel* C = &s->levels[l + 1];
+	int i;
+
+	if (l == s->count - 1) {
+		coarseSolve(s, b, x);
+		return;
+	}
+
+	/* Pre-smoothing */
+	smooth(L, b, x, 1);
+
+	/* Restrict the residual */
+	L->A->apply(L->A, x, L->res);
+#pragma omp parallel for num_threads(threads) private(i)
+	for (i = 0; i < L->n; i++) {
+		L->res[i] = b[i] - L->res[i];
+	}
+	applyCSR(&L->R, L->res, C->b, 0);
+
+	/* Coarse grid correction */
+	cycle(s, l + 1, C->b, C->x);
+	applyCSR(&L->P, C->x, x, 1);
+
+	/* Post-smoothing */
+	smooth(L, b, x, 0);
+}
+
+static void applyAMG(const struct Preconditioner* M, const floatType* r, floatType* z){
+	cycle((const struct AMGState*)M->state, 0, r, z);
+}
+
+static void destroyAMG(struct Preconditioner* M){
+	struct AMGState* s = (struct AMGState*)M->state;
+	struct AMGLevel* L;
+	int l;
+
+	for (l = 0; l < s->count; l++) {
+		L = &s->levels[l];
+		if (l > 0) {
+			destroyOperator(L->A);
+			destroyMatrix(L->data, L->indices, L->length);
+			freeLarge(L->b);
+			freeLarge(L->x);
+		}
+		if (l < s->count - 1) {
+			freeCSR(&L->P);
+			freeCSR(&L->R);
+		}
+		freeLarge(L->invDiag);
+		freeLarge(L->res);
+		if (L->d != NULL)
+			freeLarge(L->d);
+	}
+	free(s->cholesky);
+	if (s->coarseWs != NULL)
+		destroyWorkspace(s->coarseWs);
+	free(s);
+}
+
+/* Set up the vectors and the smoother of a level with matrix M */
+static void initLevel(struct AMGLevel* L, const struct CSR* M, const int coarse){
+	const int n = M->rows;
+	int i;
+
+	L->n = n;
+	L->invDiag = (floatType*)allocLarge(sizeof(floatType) * n);
+	L->res = (floatType*)allocLarge(sizeof(floatType) * n);
+	L->rho = invertDiagonal(M, L->invDiag);
+	L->omega = 4.0 / 3.0 / L->rho;
+	L->data = NULL;
+	L->indices = L->length = NULL;
+	L->b = L->x = L->d = NULL;
+	if (coarse) {
+		L->b = (floatType*)allocLarge(sizeof(floatType) * n);
+		L->x = (floatType*)allocLarge(sizeof(floatType) * n);
+	}
+	if (config.smoother == SMOOTHER_CHEBYSHEV)
+		L->d = (floatType*)allocLarge(sizeof(floatType) * n);
+#pragma omp parallel for num_threads(threads) private(i)
+	for (i = 0; i < n; i++) {
+		L->res[i] = 0.0;
+		if (coarse) {
+			L->b[i] = 0.0;
+			L->x[i] = 0.0;
+		}
+		if (L->d != NULL)
+			L->d[i] = 0.0;
+	}
+}
+
+/* Create the smoothed aggregation AMG preconditioner for the
+ * operator A with the entries in the ELLPACK-R arrays. All coarse
+ * levels are Galerkin products P^T * A * P, which are stored in the
+ * format of CG_FORMAT like the matrix itself. The cycle is one
+ * V-cycle with damped Jacobi or Chebyshev smoothing (CG_SMOOTHER). */
+struct Preconditioner* createAMGPreconditioner(const struct Operator* A, const floatType* data, const int* indices, const int* length){
+	struct Preconditioner* M;
+	struct AMGState* s;
+	struct AMGLevel* L;
+	struct CSR cur, AP, next;
+	floatType rho, theta = AMG_THETA;
+	int* agg;
+	int aggCount, maxNNZ, smoothed;
+	double total;
+
+	M = (struct Preconditioner*)malloc(sizeof(struct Preconditioner));
+	s = (struct AMGState*)malloc(sizeof(struct AMGState));
+	if (M == NULL || s == NULL) {
+		puts("Out of memory!");
+		fatalError();
+	}
+	s->cholesky = NULL;
+	s->coarseWs = NULL;
+
+	ellToCSR(A->n, data, indices, length, &cur);
+	initLevel(&s->levels[0], &cur, 0);
+	s->levels[0].A = (struct Operator*)A;
+	s->count = 1;
+	total = (double)cur.ptr[cur.rows];
+
+	while (cur.rows > AMG_COARSE_SIZE && s->count < AMG_MAX_LEVELS) {
+		L = &s->levels[s->count - 1];
+		rho = 3.0 / 4.0 / L->omega;
+
+		agg = (int*)malloc(sizeof(int) * cur.rows);
+		if (agg == NULL) {
+			puts("Out of memory!");
+			fatalError();
+		}
+		aggCount = aggregate(&cur, L->invDiag, theta, agg);
+		if (aggCount > AMG_MIN_COARSENING * cur.rows) {
+			free(agg);
+			break;
+		}
+
+		/* Galerkin product P^T * A * P. On graphs without a
+		 * geometric structure the smoothed prolongator fills the
+		 * coarse level up to a dense matrix, which would exceed the
+		 * operator complexity bound. The unsmoothed one keeps the
+		 * coarse level at most as large as the fine one. */
+		for (smoothed = 1; smoothed >= 0; smoothed--) {
+			smoothedProlongator(&cur, L->invDiag, rho, agg, aggCount, smoothed, &L->P);
+			transposeCSR(&L->P, &L->R);
+			multiplyCSR(&cur, &L->P, &AP);
+			multiplyCSR(&L->R, &AP, &next);
+			freeCSR(&AP);
+			if (total + next.ptr[next.rows] <= AMG_COMPLEXITY * A->nnz)
+				break;
+			freeCSR(&next);
+			freeCSR(&L->P);
+			freeCSR(&L->R);
+		}
+		free(agg);
+		if (smoothed < 0)
+			break;
+		total += next.ptr[next.rows];
+		freeCSR(&cur);
+		cur = next;
+
+		L = &s->levels[s->count++];
+		initLevel(L, &cur, 1);
+		csrToEll(&cur, &maxNNZ, &L->data, &L->indices, &L->length);
+		L->A = createOperator(cur.rows, cur.ptr[cur.rows], maxNNZ, L->data, L->indices, L->length);
+		theta *= 0.5;
+	}
+
+	/* The coarsest level, which may be the matrix itself if it is
+	 * small enough for the direct solver */
+	if (s->count == 1 && cur.rows > AMG_DIRECT_MAX) {
+		printf("WARNING: AMG found no coarse level, running without preconditioner.\n");
+		freeCSR(&cur);
+		freeLarge(s->levels[0].invDiag);
+		freeLarge(s->levels[0].res);
+		free(s);
+		free(M);
+		return NULL;
+	}
+	if (cur.rows <= AMG_DIRECT_MAX)
+		s->cholesky = factorize(&cur);
+	else
+		s->coarseWs = createWorkspace(cur.rows);
+	freeCSR(&cur);
+
+	snprintf(M->name, sizeof(M->name), "AMG, levels: %d, coarse: %d %s", s->count,
+	    s->levels[s->count - 1].n, s->cholesky != NULL ? "direct" : "CG");
+	M->n = A->n;
+	M->apply = applyAMG;
+	M->destroy = destroyAMG;
+	M->state = s;
+	return M;
+}
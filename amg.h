@@ -0,0 +1,25 @@
+/*****************************************************
+ * CG Solver (HPC Software Lab)
+ *
+ * Parallel Programming Models for Applications in the 
+ * Area of High-Performance Computation
+ *====================================================
+ * Smoothed aggregation multigrid preconditioner
+ *****************************************************/
+
+
+#ifndef __AMG_H__
+#define __AMG_H__
+
+#include "def.h"
+#include "solver.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+struct Preconditioner* createAMGPreconditioner(const struct Operator* A, const floatType* data, const int* indices, const int* length);
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,219 @@
+/*****************************************************
+ * CG Solver (HPC Software Lab)
+ *
+ * Parallel Programming Models for Applications in the 
+ * Area of High-Performance Computation
+ *====================================================
+ * ELLPACK-R operator in panels of columns
+ *****************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "blocked.h"
+#include "alloc.h"
+
+/* Assumed size of the last level cache if it cannot be detected */
+#define DEFAULT_CACHE (8UL * 1024 * 1024)
+
+/* A column panel of the matrix: the entries in the columns first,
+ * ..., first+columns-1 of the count rows which have any there. The
+ * r-th of these rows is row rows[r] of the matrix, with length[r]
+ * entries in the panel. They are stored in ELLPACK-R format. */
+struct Panel {
+	int count;
+	int maxNNZ;
+	int* rows;
+	int* length;
+	floatType* data;
+	int* indices;
+};
+
+struct BlockedState {
+	int columns;
+	int panels;
+	struct Panel* panel;
+};
+
+/* Return the size of the largest cache of the first processor in
+ * bytes, as listed in sysfs */
+size_t lastLevelCache(void){
+	size_t size = 0, s;
+	char path[128], unit;
+	int level, best = 0, i;
+	FILE* f;
+
+	for (i = 0; ; i++) {
+		snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/level", i);
+		if ((f = fopen(path, "r")) == NULL)
+			break;
+		if (fscanf(f, "%d", &level) != 1)
+			level = 0;
+		fclose(f);
+
+		snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/size", i);
+		if ((f = fopen(path, "r")) == NULL)
+			continue;
+		unit = 0;
+		if (fscanf(f, "%zu%c", &s, &unit) < 1)
+			s = 0;
+		fclose(f);
+		if (unit == 'K')
+			s *= 1024;
+		else if (unit == 'M')
+			s *= 1024 * 1024;
+
+		if (level > best || (level == best && s > size)) {
+			best = level;
+			size = s;
+		}
+	}
+
+	return size > 0 ? size : DEFAULT_CACHE;
+}
+
+/* y <- A*x panel by panel. The x entries of one panel stay in the
+ * cache while all rows are multiplied with them. The barrier after
+ * each panel keeps two threads from adding to the same y entry. */
+static void applyBlocked(const struct Operator* A, const floatType* x, floatType* y){
+	const struct BlockedState* s = (const struct BlockedState*)A->state;
+	const struct Panel* pn;
+	int i, j, p, r;
+	offsetType k;
+	floatType sum;
+
+#pragma omp parallel num_threads(threads) private(i, j, k, p, r, sum, pn)
+	{
+#pragma omp for
+		for (i = 0; i < A->n; i++)
+			y[i] = 0.0;
+
+		for (p = 0; p < s->panels; p++) {
+			pn = &s->panel[p];
+#pragma omp for
+			for (r = 0; r < pn->count; r++) {
+				sum = 0.0;
+				for (j = 0; j < pn->length[r]; j++) {
+					k = (offsetType)j * pn->count + r;
+					sum += pn->data[k] * x[pn->indices[k]];
+				}
+				y[pn->rows[r]] += sum;
+			}
+		}
+	}
+}
+
+static void destroyBlocked(struct Operator* A){
+	struct BlockedState* s = (struct BlockedState*)A->state;
+	int p;
+	for (p = 0; p < s->panels; p++) {
+		free(s->panel[p].rows);
+		free(s->panel[p].length);
+		freeLarge(s->panel[p].data);
+		freeLarge(s->panel[p].indices);
+	}
+	free(s->panel);
+	free(s);
+}
+
+/* Create an operator which splits the ELLPACK-R matrix into panels
+ * of columns. Half of the last level cache is left for the x entries
+ * of a panel, unless CG_PANEL sets the number of columns. The arrays
+ * are copied. */
+struct Operator* createBlockedOperator(const int n, const offsetType nnz, const int maxNNZ, const floatType* data, const int* indices, const int* length){
+	struct Operator* A;
+	struct BlockedState* s;
+	struct Panel* pn;
+	int *count, *slot;
+	int i, j, p, r;
+	offsetType k, l;
+
+	A = (struct Operator*)malloc(sizeof(struct Operator));
+	s = (struct BlockedState*)malloc(sizeof(struct BlockedState));
+	if (A == NULL || s == NULL) {
+		puts("Out of memory!");
+		fatalError();
+	}
+
+	s->columns = config.panel > 0 ? config.panel : (int)(lastLevelCache() / 2 / sizeof(floatType));
+	if (s->columns < 1 || s->columns > n)
+		s->columns = n > 0 ? n : 1;
+	s->panels = (n + s->columns - 1) / s->columns;
+	if (s->panels < 1)
+		s->panels = 1;
+
+	s->panel = (struct Panel*)calloc(s->panels, sizeof(struct Panel));
+	count = (int*)calloc(s->panels, sizeof(int));
+	slot = (int*)malloc(sizeof(int) * s->panels);
+	if (s->panel == NULL || count == NULL || slot == NULL) {
+		puts("Out of memory!");
+		fatalError();
+	}
+
+	/* Count the rows and the longest row of every panel */
+	for (i = 0; i < n; i++) {
+		for (j = 0; j < length[i]; j++)
+			count[indices[(offsetType)j * n + i] / s->columns]++;
+		for (j = 0; j < length[i]; j++) {
+			p = indices[(offsetType)j * n + i] / s->columns;
+			if (count[p] > 0) {
+				pn = &s->panel[p];
+				pn->count++;
+				if (count[p] > pn->maxNNZ)
+					pn->maxNNZ = count[p];
+				count[p] = 0;
+			}
+		}
+	}
+
+	for (p = 0; p < s->panels; p++) {
+		pn = &s->panel[p];
+		pn->rows = (int*)malloc(sizeof(int) * (pn->count + 1));
+		pn->length = (int*)calloc(pn->count + 1, sizeof(int));
+		pn->data = (floatType*)allocLarge(sizeof(floatType) * ((size_t)pn->maxNNZ * pn->count + 1));
+		pn->indices = (int*)allocLarge(sizeof(int) * ((size_t)pn->maxNNZ * pn->count + 1));
+		if (pn->rows == NULL || pn->length == NULL) {
+			puts("Out of memory!");
+			fatalError();
+		}
+		memset(pn->data, 0, sizeof(floatType) * pn->maxNNZ * pn->count);
+		memset(pn->indices, 0, sizeof(int) * pn->maxNNZ * pn->count);
+	}
+
+	/* Distribute the entries of every row over the panels. slot[p]
+	 * is the position of the current row in panel p, or -1, and
+	 * count[p] the number of rows of panel p filled so far. */
+	for (p = 0; p < s->panels; p++)
+		slot[p] = -1;
+	for (i = 0; i < n; i++) {
+		for (j = 0; j < length[i]; j++) {
+			l = (offsetType)j * n + i;
+			p = indices[l] / s->columns;
+			pn = &s->panel[p];
+			if (slot[p] < 0) {
+				slot[p] = count[p]++;
+				pn->rows[slot[p]] = i;
+			}
+			r = slot[p];
+			k = (offsetType)pn->length[r]++ * pn->count + r;
+			pn->data[k] = data[l];
+			pn->indices[k] = indices[l];
+		}
+		for (j = 0; j < length[i]; j++)
+			slot[indices[(offsetType)j * n + i] / s->columns] = -1;
+	}
+
+	free(count);
+	free(slot);
+
+	snprintf(A->format, sizeof(A->format), "blocked, %d panel(s) of %d columns", s->panels, s->columns);
+	A->n = n;
+	A->nnz = nnz;
+	A->diag = NULL;
+	A->apply = applyBlocked;
+	A->destroy = destroyBlocked;
+	A->state = s;
+	return A;
+}
@@ -0,0 +1,28 @@
+/*****************************************************
+ * CG Solver (HPC Software Lab)
+ *
+ * Parallel Programming Models for Applications in the 
+ * Area of High-Performance Computation
+ *====================================================
+ * ELLPACK-R operator in panels of columns
+ *****************************************************/
+
+
+#ifndef __BLOCKED_H__
+#define __BLOCKED_H__
+
+#include <stddef.h>
+
+#include "def.h"
+#include "solver.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+size_t lastLevelCache(void);
+struct Operator* createBlockedOperator(const int n, const offsetType nnz, const int maxNNZ, const floatType* data, const int* indices, const int* length);
+#ifdef __cplusplus
+}
+#endif
+
+#endif
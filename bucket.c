@@ -0,0 +1,238 @@
+/*****************************************************
+ * CG Solver (HPC Software Lab)
+ *
+ * Parallel Programming Models for Applications in the 
+ * Area of High-Performance Computation
+ *====================================================
+ * ELLPACK-R operator with rows grouped by length
+ *****************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bucket.h"
+#include "alloc.h"
+#include "simd.h"
+
+/* A bucket needs at least this many rows, otherwise it is merged
+ * with the bucket of the next longer rows. */
+#define BUCKET_MIN_ROWS 1024
+
+/* Number of stored entries a thread takes at once */
+#define BUCKET_CHUNK_NNZ 8192
+
+/* Rows of about the same length, stored in ELLPACK-R format with
+ * count rows, padded to the longest row of the bucket (width).
+ * The r-th row of the bucket is row rows[r] of the matrix. The
+ * rows are handed out in chunks of chunk rows. */
+struct Bucket {
+	int width;
+	int count;
+	int chunk;
+	int* rows;
+	floatType* data;
+	int* indices;
+	void (*kernel)(const struct Bucket* bk, const int first, const int last, const floatType* x, floatType* y);
+};
+
+/* All buckets of a matrix. The arrays of all buckets are parts of
+ * the blocks rows, data and indices. */
+struct BucketState {
+	int buckets;
+	struct Bucket* bucket;
+	int* rows;
+	floatType* data;
+	int* indices;
+};
+
+/* y <- A*x for the rows first, ..., last-1 of a bucket */
+static void bucketKernel(const struct Bucket* bk, const int first, const int last, const floatType* x, floatType* y){
+	int r, j;
+	offsetType k;
+	floatType sum;
+	for (r = first; r < last; r++) {
+		sum = 0.0;
+		for (j = 0; j < bk->width; j++) {
+			k = (offsetType)j * bk->count + r;
+			sum += bk->data[k] * x[bk->indices[k]];
+		}
+		y[bk->rows[r]] = sum;
+	}
+}
+
+/* The same for buckets of width W with the loop over the entries
+ * of a row unrolled completely */
+#define BUCKET_KERNEL(W) \
+static void bucketKernel##W(const struct Bucket* bk, const int first, const int last, const floatType* x, floatType* y){ \
+	const int count = bk->count; \
+	int r, j; \
+	offsetType k; \
+	floatType sum; \
+	for (r = first; r < last; r++) { \
+		sum = 0.0; \
+		FIXED_UNROLL \
+		for (j = 0; j < W; j++) { \
+			k = (offsetType)j * count + r; \
+			sum += bk->data[k] * x[bk->indices[k]]; \
+		} \
+		y[bk->rows[r]] = sum; \
+	} \
+}
+
+BUCKET_KERNEL(3)
+BUCKET_KERNEL(5)
+BUCKET_KERNEL(7)
+BUCKET_KERNEL(9)
+BUCKET_KERNEL(27)
+
+static void (* const bucketKernels[FIXED_WIDTHS])(const struct Bucket*, const int, const int, const floatType*, floatType*) = {
+	bucketKernel3, bucketKernel5, bucketKernel7, bucketKernel9, bucketKernel27
+};
+
+/* y <- A*x bucket by bucket. All buckets are processed in one
+ * parallel region. As they write disjoint rows of y, a thread
+ * continues with the next bucket without waiting for the others. */
+static void applyBucket(const struct Operator* A, const floatType* x, floatType* y){
+	const struct BucketState* s = (const struct BucketState*)A->state;
+	const struct Bucket* bk;
+	int b, c, chunks, last;
+
+#pragma omp parallel num_threads(threads) private(b, c, chunks, last, bk)
+	for (b = 0; b < s->buckets; b++) {
+		bk = &s->bucket[b];
+		chunks = (bk->count + bk->chunk - 1) / bk->chunk;
+#pragma omp for schedule(dynamic, 1) nowait
+		for (c = 0; c < chunks; c++) {
+			last = (c + 1) * bk->chunk;
+			if (last > bk->count)
+				last = bk->count;
+			bk->kernel(bk, c * bk->chunk, last, x, y);
+		}
+	}
+}
+
+static void destroyBucket(struct Operator* A){
+	struct BucketState* s = (struct BucketState*)A->state;
+	freeLarge(s->rows);
+	freeLarge(s->data);
+	freeLarge(s->indices);
+	free(s->bucket);
+	free(s);
+}
+
+/* Create an operator which stores the rows of the ELLPACK-R matrix
+ * grouped by their length. Each bucket is only padded to its own
+ * width instead of maxNNZ, and is multiplied by a kernel for that
+ * width. The arrays are copied. */
+struct Operator* createBucketOperator(const int n, const offsetType nnz, const int maxNNZ, const floatType* data, const int* indices, const int* length){
+	struct Operator* A;
+	struct BucketState* s;
+	struct Bucket* bk;
+	int *histogram, *bucketOf, *next;
+	int i, j, l, b, r, w, rows;
+	offsetType k, stored, offset;
+
+	A = (struct Operator*)malloc(sizeof(struct Operator));
+	s = (struct BucketState*)malloc(sizeof(struct BucketState));
+	histogram = (int*)calloc(maxNNZ + 1, sizeof(int));
+	bucketOf = (int*)malloc(sizeof(int) * (maxNNZ + 1));
+	if (A == NULL || s == NULL || histogram == NULL || bucketOf == NULL) {
+		puts("Out of memory!");
+		fatalError();
+	}
+
+	/* Close a bucket at length l as soon as it has enough rows */
+	for (i = 0; i < n; i++)
+		histogram[length[i]]++;
+	s->buckets = 0;
+	rows = 0;
+	for (l = 0; l <= maxNNZ; l++) {
+		bucketOf[l] = s->buckets;
+		rows += histogram[l];
+		if (rows >= BUCKET_MIN_ROWS || (l == maxNNZ && rows > 0)) {
+			s->buckets++;
+			rows = 0;
+		}
+	}
+
+	s->bucket = (struct Bucket*)calloc(s->buckets + 1, sizeof(struct Bucket));
+	next = (int*)calloc(s->buckets + 1, sizeof(int));
+	if (s->bucket == NULL || next == NULL) {
+		puts("Out of memory!");
+		fatalError();
+	}
+	for (l = 0; l <= maxNNZ; l++) {
+		bk = &s->bucket[bucketOf[l]];
+		bk->count += histogram[l];
+		if (histogram[l] > 0)
+			bk->width = l;
+	}
+
+	/* Place the buckets one after another in the blocks */
+	stored = 0;
+	for (b = 0; b < s->buckets; b++)
+		stored += (offsetType)s->bucket[b].width * s->bucket[b].count;
+	s->rows = (int*)allocLarge(sizeof(int) * n);
+	s->data = (floatType*)allocLarge(sizeof(floatType) * stored);
+	s->indices = (int*)allocLarge(sizeof(int) * stored);
+
+	r = 0;
+	offset = 0;
+	for (b = 0; b < s->buckets; b++) {
+		bk = &s->bucket[b];
+		bk->rows = s->rows + r;
+		bk->data = s->data + offset;
+		bk->indices = s->indices + offset;
+		r += bk->count;
+		offset += (offsetType)bk->width * bk->count;
+
+		/* Wide buckets get smaller chunks */
+		bk->chunk = bk->width > 0 ? BUCKET_CHUNK_NNZ / bk->width : BUCKET_CHUNK_NNZ;
+		if (bk->chunk < 1)
+			bk->chunk = 1;
+
+		bk->kernel = bucketKernel;
+		for (w = 0; w < FIXED_WIDTHS; w++)
+			if (bk->width == fixedWidth[w])
+				bk->kernel = bucketKernels[w];
+	}
+
+	/* The rows keep their order within a bucket */
+	for (i = 0; i < n; i++) {
+		bk = &s->bucket[bucketOf[length[i]]];
+		bk->rows[next[bucketOf[length[i]]]++] = i;
+	}
+
+	/* Copy the rows and pad them to the width of their bucket */
+	for (b = 0; b < s->buckets; b++) {
+		bk = &s->bucket[b];
+#pragma omp parallel for num_threads(threads) private(i, j, k, r)
+		for (r = 0; r < bk->count; r++) {
+			i = bk->rows[r];
+			for (j = 0; j < bk->width; j++) {
+				k = (offsetType)j * bk->count + r;
+				if (j < length[i]) {
+					bk->data[k] = data[(offsetType)j * n + i];
+					bk->indices[k] = indices[(offsetType)j * n + i];
+				} else {
+					bk->data[k] = 0.0;
+					bk->indices[k] = 0;
+				}
+			}
+		}
+	}
+
+	free(histogram);
+	free(bucketOf);
+	free(next);
+
+	snprintf(A->format, sizeof(A->format), "buckets (%d)", s->buckets);
+	A->n = n;
+	A->nnz = nnz;
+	A->diag = NULL;
+	A->apply = applyBucket;
+	A->destroy = destroyBucket;
+	A->state = s;
+	return A;
+}
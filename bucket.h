@@ -0,0 +1,25 @@
+/*****************************************************
+ * CG Solver (HPC Software Lab)
+ *
+ * Parallel Programming Models for Applications in the 
+ * Area of High-Performance Computation
+ *====================================================
+ * ELLPACK-R operator with rows grouped by length
+ *****************************************************/
+
+
+#ifndef __BUCKET_H__
+#define __BUCKET_H__
+
+#include "def.h"
+#include "solver.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+struct Operator* createBucketOperator(const int n, const offsetType nnz, const int maxNNZ, const floatType* data, const int* indices, const int* length);
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,268 @@
+/*****************************************************
+ * CG Solver (HPC Software Lab)
+ *
+ * Parallel Programming Models for Applications in the 
+ * Area of High-Performance Computation
+ *====================================================
+ * Library interface of the solver
+ *****************************************************/
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+
+#include "cglib.h"
+#include "io.h"
+#include "solver.h"
+#include "alloc.h"
+#include "partition.h"
+#include "precond.h"
+
+/* A matrix as handed over by the application, stored in
+ * coordinate format with 0-based indices. */
+struct CGMatrix {
+	int n;
+	offsetType nnz;
+	int *I, *J;
+	floatType *V;
+};
+
+/* Everything the solver needs for repeated solves: the matrix
+ * in ELLPACK-R format, the scratch vectors, and the configuration
+ * and statistics of the last solve. If the matrix was renumbered
+ * (perm != NULL), b and x are permuted into pb and px. */
+struct CGSolver {
+	int n;
+	offsetType nnz;
+	int maxNNZ;
+	floatType* data;
+	int* indices;
+	int* length;
+	int* perm;
+	floatType *pb, *px;
+	struct Operator* op;
+	struct Preconditioner* precond;
+	struct Workspace* ws;
+	struct SolverConfig sc;
+};
+
+/* The solver code prints an error message and calls fatalError().
+ * In the library this jumps back to the entry point, which runs in
+ * the calling thread, and the entry point returns the error to the
+ * application. Memory of a data structure, which was half built at
+ * the error, is lost. */
+static __thread jmp_buf* trap = NULL;
+
+static void leaveLibrary(void){
+	if (trap != NULL)
+		longjmp(*trap, 1);
+}
+
+/* Catch the errors in the entry point, which has called setjmp(buf).
+ * The progress messages of the executable are not printed. */
+static void enterLibrary(jmp_buf* buf){
+	errorHandler = leaveLibrary;
+	trap = buf;
+	config.verbose = 0;
+}
+
+/* Read the configuration from the environment. 0 is returned for
+ * an invalid configuration, 1 otherwise. */
+int cgInit(void){
+	jmp_buf buf;
+
+	if (setjmp(buf) != 0) {
+		trap = NULL;
+		return 0;
+	}
+	enterLibrary(&buf);
+	init();
+	trap = NULL;
+	return 1;
+}
+
+/* Load a matrix from the matrix market file "filename". NULL is
+ * returned if the file cannot be read. */
+CGMatrix* cgMatrixLoad(char *filename){
+	CGMatrix* A;
+	jmp_buf buf;
+
+	if ((A = (CGMatrix*)malloc(sizeof(CGMatrix))) == NULL)
+		return NULL;
+	A->I = A->J = NULL;
+	A->V = NULL;
+
+	if (setjmp(buf) != 0) {
+		trap = NULL;
+		cgMatrixDestroy(A);
+		return NULL;
+	}
+	enterLibrary(&buf);
+	readMM(filename, &A->n, &A->nnz, &A->I, &A->J, &A->V);
+	trap = NULL;
+
+	return A;
+}
+
+/* Create a n x n matrix from nnz entries in coordinate format.
+ * I, J and V are copied, so the caller keeps their ownership.
+ * NULL is returned for indices outside of the matrix, and for
+ * more entries than this build supports (see "make large=1"). nnz
+ * is long long instead of offsetType, so that the interface does
+ * not depend on the build of the library. */
+CGMatrix* cgMatrixFromCOO(const int n, const long long nnz, const int* I, const int* J, const floatType* V){
+	CGMatrix* A;
+	offsetType k;
+
+	if (nnz < 0 || nnz > OFFSET_MAX)
+		return NULL;
+
+	for (k = 0; k < nnz; k++) {
+		if (I[k] < 0 || I[k] >= n || J[k] < 0 || J[k] >= n)
+			return NULL;
+	}
+
+	if ((A = (CGMatrix*)malloc(sizeof(CGMatrix))) == NULL)
+		return NULL;
+
+	A->n = n;
+	A->nnz = nnz;
+	A->I = (int*)malloc(sizeof(int) * (size_t)nnz);
+	A->J = (int*)malloc(sizeof(int) * (size_t)nnz);
+	A->V = (floatType*)malloc(sizeof(floatType) * (size_t)nnz);
+
+	if (A->I == NULL || A->J == NULL || A->V == NULL) {
+		cgMatrixDestroy(A);
+		return NULL;
+	}
+
+	memcpy(A->I, I, sizeof(int) * (size_t)nnz);
+	memcpy(A->J, J, sizeof(int) * (size_t)nnz);
+	memcpy(A->V, V, sizeof(floatType) * (size_t)nnz);
+
+	return A;
+}
+
+/* Return the dimension n of the matrix */
+int cgMatrixSize(const CGMatrix* A){
+	return A->n;
+}
+
+/* Free the matrix. Solvers created from it stay valid. */
+void cgMatrixDestroy(CGMatrix* A){
+	free(A->I);
+	free(A->J);
+	free(A->V);
+	free(A);
+}
+
+/* Convert the matrix to ELLPACK-R, renumber it for the NUMA
+ * domains if CG_PARTITION is set, and allocate the workspace
+ * for solving with at most maxIter iterations until the
+ * residual is reduced by tolerance. NULL is returned if there is
+ * not enough memory. */
+CGSolver* cgSolverSetup(const CGMatrix* A, const int maxIter, const floatType tolerance){
+	CGSolver* s;
+	jmp_buf buf;
+
+	if ((s = (CGSolver*)calloc(1, sizeof(CGSolver))) == NULL)
+		return NULL;
+
+	if (setjmp(buf) != 0) {
+		trap = NULL;
+		cgSolverDestroy(s);
+		return NULL;
+	}
+	enterLibrary(&buf);
+
+	s->n = A->n;
+	s->nnz = A->nnz;
+	cooToEll(A->n, A->nnz, A->I, A->J, A->V, &s->maxNNZ, &s->data, &s->indices, &s->length);
+
+	if (config.partition) {
+		if ((s->perm = (int*)malloc(sizeof(int) * A->n)) == NULL) {
+			puts("Out of memory!");
+			fatalError();
+		}
+		partitionGraph(A->n, s->indices, s->length, s->perm);
+		if (remoteAccesses(A->n, s->indices, s->length, numaDomains(), s->perm) <
+		    remoteAccesses(A->n, s->indices, s->length, numaDomains(), NULL)) {
+			permuteMatrix(A->n, s->maxNNZ, &s->data, &s->indices, &s->length, s->perm);
+			s->pb = (floatType*)allocLarge(sizeof(floatType) * A->n);
+			s->px = (floatType*)allocLarge(sizeof(floatType) * A->n);
+		} else {
+			free(s->perm);
+			s->perm = NULL;
+		}
+	}
+
+	s->op = createOperator(A->n, A->nnz, s->maxNNZ, s->data, s->indices, s->length);
+	s->precond = createPreconditioner(s->op, s->maxNNZ, s->data, s->indices, s->length);
+	s->ws = createWorkspace(A->n);
+	if (config.deflate > 0)
+		s->ws->deflation = createDeflation(A->n, config.deflate, config.deflateWindow);
+
+	memset(&s->sc, 0, sizeof(s->sc));
+	s->sc.maxIter = maxIter;
+	s->sc.tolerance = tolerance;
+	s->sc.verbose = 0;
+	s->sc.checkpointFile = NULL;
+	s->sc.restartFile = NULL;
+	trap = NULL;
+
+	return s;
+}
+
+/* Solve A * x = b. On entry x holds the initial guess, on exit
+ * the solution. 1 is returned in case of convergence, 0 otherwise. */
+int cgSolverSolve(CGSolver* s, const floatType* b, floatType* x){
+	jmp_buf buf;
+
+	if (setjmp(buf) != 0) {
+		trap = NULL;
+		return 0;
+	}
+	enterLibrary(&buf);
+
+	if (s->perm != NULL) {
+		permuteVector(s->n, s->perm, b, s->pb);
+		permuteVector(s->n, s->perm, x, s->px);
+		cg(s->op, s->precond, s->pb, s->px, &s->sc, s->ws);
+		unpermuteVector(s->n, s->perm, s->px, x);
+	} else {
+		cg(s->op, s->precond, b, x, &s->sc, s->ws);
+	}
+	trap = NULL;
+
+	return (s->sc.residual <= s->sc.tolerance) ? 1 : 0;
+}
+
+/* Return the iterations, the normalized residual and the time
+ * spent in the matrix vector product of the last solve. Any of
+ * the pointers may be NULL. */
+void cgSolverInfo(const CGSolver* s, int* iter, floatType* residual, double* timeMatvec){
+	if (iter != NULL)
+		*iter = s->sc.iter;
+	if (residual != NULL)
+		*residual = s->sc.residual;
+	if (timeMatvec != NULL)
+		*timeMatvec = s->sc.timeMatvec;
+}
+
+/* Free the matrix and the workspace of the solver. It also frees
+ * a solver, which cgSolverSetup() has built only partly. */
+void cgSolverDestroy(CGSolver* s){
+	destroyPreconditioner(s->precond);
+	if (s->op != NULL)
+		destroyOperator(s->op);
+	destroyMatrix(s->data, s->indices, s->length);
+	if (s->ws != NULL)
+		destroyWorkspace(s->ws);
+	free(s->perm);
+	freeLarge(s->pb);
+	freeLarge(s->px);
+	free(s);
+}
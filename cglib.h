@@ -0,0 +1,54 @@
+/*****************************************************
+ * CG Solver (HPC Software Lab)
+ *
+ * Parallel Programming Models for Applications in the 
+ * Area of High-Performance Computation
+ *====================================================
+ * Library interface of the solver
+ *****************************************************/
+
+#ifndef __CGLIB_H__
+#define __CGLIB_H__
+
+#include "def.h"
+
+/* Library interface of the CG solver. A matrix is loaded once into
+ * a CGMatrix. cgSolverSetup() converts it into the storage format
+ * of the solver and allocates all scratch memory, so that every
+ * following cgSolverSolve() runs without any allocation.
+ * cgInit() applies the CG_* environment variables (see help()) to
+ * all following calls, otherwise the defaults are used.
+ * The library never exits the application: an error is printed
+ * and the function returns NULL, or 0 where an int is returned.
+ * Progress messages of the cg.exe are not printed.
+ *
+ * Example:
+ *	cgInit();
+ *	CGMatrix *A = cgMatrixLoad("G3_circuit.mtx");
+ *	CGSolver *s = cgSolverSetup(A, 6000, 1e-7);
+ *	cgMatrixDestroy(A);
+ *	for (...) {
+ *		cgSolverSolve(s, b, x);
+ *	}
+ *	cgSolverDestroy(s); */
+typedef struct CGMatrix CGMatrix;
+typedef struct CGSolver CGSolver;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+int cgInit(void);
+CGMatrix* cgMatrixLoad(char *filename);
+CGMatrix* cgMatrixFromCOO(const int n, const long long nnz, const int* I, const int* J, const floatType* V);
+int cgMatrixSize(const CGMatrix* A);
+void cgMatrixDestroy(CGMatrix* A);
+
+CGSolver* cgSolverSetup(const CGMatrix* A, const int maxIter, const floatType tolerance);
+int cgSolverSolve(CGSolver* s, const floatType* b, floatType* x);
+void cgSolverInfo(const CGSolver* s, int* iter, floatType* residual, double* timeMatvec);
+void cgSolverDestroy(CGSolver* s);
+#ifdef __cplusplus
+}
+#endif
+
+#endif
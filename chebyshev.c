@@ -0,0 +1,225 @@
+/*****************************************************
+ * CG Solver (HPC Software Lab)
+ *
+ * Parallel Programming Models for Applications in the 
+ * Area of High-Performance Computation
+ *====================================================
+ * Chebyshev polynomial preconditioner
+ *****************************************************/
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "chebyshev.h"
+#include "alloc.h"
+
+/* Number of CG steps for the eigenvalue estimates at setup */
+#define LANCZOS_STEPS 20
+
+/* The largest eigenvalue estimate is raised by this factor. The
+ * Lanczos estimate approaches it from below, but the polynomial
+ * is only positive up to the upper bound of the interval. */
+#define LANCZOS_SAFETY 1.1
+
+/* Chebyshev polynomial in A on the eigenvalue interval [lmin, lmax].
+ * d and w are scratch vectors. */
+struct ChebyshevState {
+	const struct Operator* A;
+	int degree;
+	floatType lmin, lmax;
+	floatType *d, *w;
+};
+
+/* Number of eigenvalues of the symmetric tridiagonal matrix with
+ * diagonal a and off-diagonal b, which are smaller than s (Sturm
+ * sequence). */
+static int eigenvaluesBelow(const int m, const floatType* a, const floatType* b, const floatType s){
+	floatType q = 1.0;
+	int i, count = 0;
+
+	for (i = 0; i < m; i++) {
+		q = a[i] - s - (i > 0 ? b[i - 1] * b[i - 1] / q : 0.0);
+		if (q == 0.0)
+			q = -1e-300;
+		if (q < 0.0)
+			count++;
+	}
+	return count;
+}
+
+/* The k-th smallest eigenvalue of the tridiagonal matrix by
+ * bisection within its Gershgorin interval */
+static floatType tridiagonalEigenvalue(const int m, const floatType* a, const floatType* b, const int k){
+	floatType lo, hi, mid, r;
+	int i, step;
+
+	lo = a[0];
+	hi = a[0];
+	for (i = 0; i < m; i++) {
+		r = (i > 0 ? fabs(b[i - 1]) : 0.0) + (i < m - 1 ? fabs(b[i]) : 0.0);
+		if (a[i] - r < lo)
+			lo = a[i] - r;
+		if (a[i] + r > hi)
+			hi = a[i] + r;
+	}
+
+	for (step = 0; step < 100; step++) {
+		mid = 0.5 * (lo + hi);
+		if (eigenvaluesBelow(m, a, b, mid) > k)
+			hi = mid;
+		else
+			lo = mid;
+	}
+	return 0.5 * (lo + hi);
+}
+
+/* Estimate the extreme eigenvalues of A with the given number of
+ * unpreconditioned CG steps. The coefficients alpha and beta of
+ * cg() define the Lanczos matrix T of A with
+ *   T(k,k)   = 1/alpha(k) + beta(k-1)/alpha(k-1)
+ *   T(k,k+1) = sqrt(beta(k))/alpha(k),
+ * whose extreme eigenvalues converge quickly to the ones of A.
+ * The right hand side is a fixed pseudo random vector. */
+void lanczosBounds(const struct Operator* A, const int steps, floatType* lmin, floatType* lmax){
+	const int n = A->n;
+	struct SolverConfig sc;
+	struct Workspace* ws;
+	floatType *b, *x, *alphas, *betas, *diag, *off;
+	unsigned int seed = 12345;
+	int i, m;
+
+	b = (floatType*)allocLarge(sizeof(floatType) * n);
+	x = (floatType*)allocLarge(sizeof(floatType) * n);
+	alphas = (floatType*)malloc(sizeof(floatType) * steps);
+	betas = (floatType*)malloc(sizeof(floatType) * steps);
+	diag = (floatType*)malloc(sizeof(floatType) * steps);
+	off = (floatType*)malloc(sizeof(floatType) * steps);
+	if (alphas == NULL || betas == NULL || diag == NULL || off == NULL) {
+		puts("Out of memory!");
+		fatalError();
+	}
+	for (i = 0; i < n; i++) {
+		seed = seed * 1103515245 + 12345;
+		b[i] = (seed >> 16) / 32768.0 - 1.0;
+		x[i] = 0.0;
+	}
+	ws = createWorkspace(n);
+
+	sc.maxIter = steps < n ? steps : n;
+	sc.tolerance = 1e-10;
+	sc.verbose = 0;
+	sc.checkpointFile = NULL;
+	sc.checkpointInterval = 0;
+	sc.restartFile = NULL;
+	sc.alphas = alphas;
+	sc.betas = betas;
+	cg(A, NULL, b, x, &sc, ws);
+
+	/* The iteration which converged has an alpha, but no beta */
+	m = (sc.iter < sc.maxIter) ? sc.iter + 1 : sc.iter;
+	for (i = 0; i < m; i++) {
+		diag[i] = 1.0 / alphas[i] + (i > 0 ? betas[i - 1] / alphas[i - 1] : 0.0);
+		if (i < m - 1)
+			off[i] = sqrt(betas[i]) / alphas[i];
+	}
+	*lmin = tridiagonalEigenvalue(m, diag, off, 0);
+	*lmax = tridiagonalEigenvalue(m, diag, off, m - 1);
+
+	destroyWorkspace(ws);
+	freeLarge(b);
+	freeLarge(x);
+	free(alphas);
+	free(betas);
+	free(diag);
+	free(off);
+}
+
+/* z <- p(A) * r, the Chebyshev iteration for A*z = r with z(0) = 0
+ * (Saad, Iterative Methods for Sparse Linear Systems, Alg. 12.1):
+ *   d(0) = r / theta, z(1) = d(0)
+ *   d(k) = rho(k)*rho(k-1) * d(k-1) + 2*rho(k)/delta * (r - A*z(k))
+ *   z(k+1) = z(k) + d(k)
+ * with theta and delta the center and half width of the interval.
+ * Besides the matvecs there are no reductions, each step is one
+ * fused pass over the vectors. */
+static void applyChebyshev(const struct Preconditioner* M, const floatType* r, floatType* z){
+	const struct ChebyshevState* s = (const struct ChebyshevState*)M->state;
+	const int n = M->n;
+	const floatType theta = 0.5 * (s->lmax + s->lmin);
+	const floatType delta = 0.5 * (s->lmax - s->lmin);
+	const floatType sigma = theta / delta;
+	floatType rho, rhoNew, c1, c2;
+	floatType *d = s->d, *w = s->w;
+	int i, k;
+
+#pragma omp parallel for num_threads(threads) private(i)
+	for (i = 0; i < n; i++) {
+		d[i] = r[i] / theta;
+		z[i] = d[i];
+	}
+
+	rho = 1.0 / sigma;
+	for (k = 1; k <= s->degree; k++) {
+		s->A->apply(s->A, z, w);
+		rhoNew = 1.0 / (2.0 * sigma - rho);
+		c1 = rhoNew * rho;
+		c2 = 2.0 * rhoNew / delta;
+#pragma omp parallel for num_threads(threads) private(i)
+		for (i = 0; i < n; i++) {
+			d[i] = c1 * d[i] + c2 * (r[i] - w[i]);
+			z[i] += d[i];
+		}
+		rho = rhoNew;
+	}
+}
+
+static void destroyChebyshev(struct Preconditioner* M){
+	struct ChebyshevState* s = (struct ChebyshevState*)M->state;
+	freeLarge(s->d);
+	freeLarge(s->w);
+	free(s);
+}
+
+/* Create the Chebyshev preconditioner of the given degree, which
+ * applies A degree times. It only needs the operator, which
+ * must stay valid as long as the preconditioner is used. */
+struct Preconditioner* createChebyshevPreconditioner(const struct Operator* A, const int degree){
+	struct Preconditioner* M;
+	struct ChebyshevState* s;
+	const int n = A->n;
+	int i;
+
+	M = (struct Preconditioner*)malloc(sizeof(struct Preconditioner));
+	s = (struct ChebyshevState*)malloc(sizeof(struct ChebyshevState));
+	if (M == NULL || s == NULL) {
+		puts("Out of memory!");
+		fatalError();
+	}
+
+	lanczosBounds(A, LANCZOS_STEPS, &s->lmin, &s->lmax);
+	s->lmax *= LANCZOS_SAFETY;
+	if (s->lmin <= 0.0 || s->lmin >= s->lmax) {
+		printf("ERROR: No valid eigenvalue bounds [%e, %e] for Chebyshev, is the matrix positive definite?\n", s->lmin, s->lmax);
+		fatalError();
+	}
+
+	s->A = A;
+	s->degree = degree;
+	s->d = (floatType*)allocLarge(sizeof(floatType) * n);
+	s->w = (floatType*)allocLarge(sizeof(floatType) * n);
+#pragma omp parallel for num_threads(threads) private(i)
+	for (i = 0; i < n; i++) {
+		s->d[i] = 0.0;
+		s->w[i] = 0.0;
+	}
+
+	snprintf(M->name, sizeof(M->name), "Chebyshev, degree %d, [%.3g, %.3g]", degree, s->lmin, s->lmax);
+	M->n = n;
+	M->apply = applyChebyshev;
+	M->destroy = destroyChebyshev;
+	M->state = s;
+	return M;
+}
@@ -0,0 +1,26 @@
+/*****************************************************
+ * CG Solver (HPC Software Lab)
+ *
+ * Parallel Programming Models for Applications in the 
+ * Area of High-Performance Computation
+ *====================================================
+ * Chebyshev polynomial preconditioner
+ *****************************************************/
+
+
+#ifndef __CHEBYSHEV_H__
+#define __CHEBYSHEV_H__
+
+#include "def.h"
+#include "solver.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+void lanczosBounds(const struct Operator* A, const int steps, floatType* lmin, floatType* lmax);
+struct Preconditioner* createChebyshevPreconditioner(const struct Operator* A, const int degree);
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,324 @@
+/*****************************************************
+ * CG Solver (HPC Software Lab)
+ *
+ * Parallel Programming Models for Applications in the 
+ * Area of High-Performance Computation
+ *====================================================
+ * CG as OpenMP tasks over blocks of rows
+ *****************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "dataflow.h"
+#include "io.h"
+
+
+/* Index of the block, which contains row i */
+static int blockOf(const struct TaskMatrix* T, const int i){
+	int lo = 0, hi = T->blocks - 1, mid;
+
+	while (lo < hi) {
+		mid = (lo + hi + 1) / 2;
+		if (T->start[mid] <= i)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+	return lo;
+}
+
+/* Split the matrix into blocks of rows. The arrays are kept, but
+ * must stay valid until destroyTaskMatrix(). */
+struct TaskMatrix* createTaskMatrix(const int n, const offsetType nnz, const int maxNNZ, const floatType* data, const int* indices, const int* length, const int blocks){
+	struct TaskMatrix* T;
+	int b, i, j, first, last;
+	offsetType k;
+
+	T = (struct TaskMatrix*)malloc(sizeof(struct TaskMatrix));
+	if (T == NULL) {
+		puts("Out of memory!");
+		fatalError();
+	}
+	T->n = n;
+	T->nnz = nnz;
+	T->maxNNZ = maxNNZ;
+	T->data = data;
+	T->indices = indices;
+	T->length = length;
+	T->blocks = (blocks < n) ? blocks : n;
+	T->start = (int*)malloc(sizeof(int) * (T->blocks + 1));
+	T->lo = (int*)malloc(sizeof(int) * T->blocks);
+	T->hi = (int*)malloc(sizeof(int) * T->blocks);
+	if (T->start == NULL || T->lo == NULL || T->hi == NULL) {
+		puts("Out of memory!");
+		fatalError();
+	}
+
+	for (b = 0; b <= T->blocks; b++)
+		T->start[b] = (int)((long long)b * n / T->blocks);
+
+	/* Find the range of x entries, which every block uses */
+#pragma omp parallel for num_threads(threads) private(b, i, j, k, first, last)
+	for (b = 0; b < T->blocks; b++) {
+		first = last = T->start[b];
+		for (i = T->start[b]; i < T->start[b + 1]; i++) {
+			for (j = 0; j < length[i]; j++) {
+				k = (offsetType)j * n + i;
+				if (indices[k] < first)
+					first = indices[k];
+				if (indices[k] > last)
+					last = indices[k];
+			}
+		}
+		T->lo[b] = blockOf(T, first);
+		T->hi[b] = blockOf(T, last);
+	}
+
+	snprintf(T->name, sizeof(T->name), "ELLPACK-R, %d task blocks", T->blocks);
+	return T;
+}
+
+void destroyTaskMatrix(struct TaskMatrix* T){
+	free(T->start);
+	free(T->lo);
+	free(T->hi);
+	free(T);
+}
+
+#ifdef HAVE_TASK_CG
+
+/* y <- A*x for the rows of block b */
+static void matvecBlock(const struct TaskMatrix* T, const int b, const floatType* x, floatType* y){
+	const int n = T->n;
+	int i, j;
+	offsetType k;
+	floatType temp;
+
+	for (i = T->start[b]; i < T->start[b + 1]; i++) {
+		temp = 0.0;
+		for (j = 0; j < T->length[i]; j++) {
+			k = (offsetType)j * n + i;
+			temp += T->data[k] * x[T->indices[k]];
+		}
+		y[i] = temp;
+	}
+}
+
+/* a' * b for the rows of block b */
+static floatType dotBlock(const struct TaskMatrix* T, const int blk, const floatType* a, const floatType* b){
+	floatType temp = 0.0;
+	int i;
+
+	for (i = T->start[blk]; i < T->start[blk + 1]; i++)
+		temp += a[i] * b[i];
+	return temp;
+}
+
+
+/***************************************
+ *  Conjugate Gradient with OpenMP     *
+ *  tasks. It computes the same        *
+ *  iterations as cg() without a       *
+ *  preconditioner, but every step is  *
+ *  a task per block of rows and the   *
+ *  tasks only wait for the blocks     *
+ *  they read:                         *
+ ***************************************
+ q_b(k)    = A_b * p(k)    after the blocks lo[b] ... hi[b] of p(k)
+ pq_b      = <p_b(k),q_b(k)>
+ alpha     = rho(k) / sum pq_b    after all pq_b
+ x_b(k+1)  = x_b(k) + alpha*p_b(k)
+ r_b(k+1)  = r_b(k) - alpha*q_b(k)
+ rr_b      = <r_b(k+1),r_b(k+1)>
+ rho(k+1)  = sum rr_b             after all rr_b
+ beta      = rho(k+1) / rho(k)
+ p_b(k+1)  = r_b(k+1) + beta*p_b(k)
+ ***************************************
+ Only the convergence check waits for
+ rho(k+1), so threads which are done
+ with their blocks start with the next
+ step instead of idling at a barrier.
+ The partial sums are added in block
+ order, so the results do not depend
+ on the number of threads.
+***************************************/
+void taskCg(const struct TaskMatrix* T, const floatType* b, floatType* x, struct SolverConfig* sc, struct Workspace* ws){
+	const int n = T->n, blocks = T->blocks;
+	const int* start = T->start;
+	floatType* r = ws->r, *p = ws->p, *q = ws->q;
+	floatType *pq, *rr, *busy;
+	floatType alpha[2], beta[2], rho[2], bnrm2;
+	int iter, first, i, failed = 0;
+	double timeMatvec = 0.0;
+
+	pq = (floatType*)malloc(sizeof(floatType) * blocks);
+	rr = (floatType*)malloc(sizeof(floatType) * blocks);
+	busy = (floatType*)malloc(sizeof(floatType) * blocks);
+	if (pq == NULL || rr == NULL || busy == NULL) {
+		puts("Out of memory!");
+		fatalError();
+	}
+	for (i = 0; i < blocks; i++)
+		busy[i] = 0.0;
+
+	DBGVEC("b = ", b, n);
+	DBGVEC("x = ", x, n);
+
+	if (sc->restartFile != NULL) {
+		/* Continue exactly where the checkpoint was written */
+		readCheckpoint(sc->restartFile, n, x, r, p, &rho[0], &bnrm2, &first);
+		rho[first & 1] = rho[0];
+		if (sc->verbose)
+			printf("Restart from iteration %d\n", first);
+	} else {
+		/* r(0)    = b - Ax(0) */
+		timeMatvec = getWTime();
+#pragma omp parallel for num_threads(threads) private(i)
+		for (i = 0; i < blocks; i++)
+			matvecBlock(T, i, x, r);
+		timeMatvec = getWTime() - timeMatvec;
+		xpay(b, -1.0, n, r);
+		DBGVEC("r = b - Ax = ", r, n);
+
+		/* Normalize all residuals with ||b||_2 as in cg() */
+		nrm2(b, n, &bnrm2, ws);
+		bnrm2 = 1.0 /bnrm2;
+
+		/* p(0)    = r(0) */
+		memcpy(p, r, n*sizeof(floatType));
+		DBGVEC("p = r = ", p, n);
+
+		/* rho(0)    =  <r(0),r(0)> */
+		vectorDot(r, r, n, &rho[0], ws);
+		if (sc->verbose)
+			printf("rho_0=%e\n", rho[0]);
+
+		first = 0;
+	}
+	sc->residual = sqrt(rho[first & 1]) * bnrm2;
+
+	/* One thread creates the tasks of an iteration, all threads
+	 * execute them. The scalars of iteration k are stored at
+	 * index k & 1, so the tasks of the next iteration do not
+	 * have to wait for the readers of the current values. */
+#pragma omp parallel num_threads(threads)
+#pragma omp single
+	for (iter = first; iter < sc->maxIter && sc->residual > sc->tolerance; iter++) {
+		const int cur = iter & 1, nxt = cur ^ 1;
+		int blk;
+
+		/* q(k) = A * p(k) and the parts of <p(k),q(k)> */
+		for (blk = 0; blk < blocks; blk++) {
+#pragma omp task depend(iterator(j = T->lo[blk] : T->hi[blk] + 1), in: p[start[j]]) depend(out: q[start[blk]], pq[blk])
+			{
+				double timeMatvec_s = getWTime();
+				matvecBlock(T, blk, p, q);
+				pq[blk] = dotBlock(T, blk, p, q);
+				busy[blk] += getWTime() - timeMatvec_s;
+			}
+		}
+
+		/* alpha = rho(k) / <p(k),q(k)> */
+#pragma omp task depend(iterator(j = 0 : blocks), in: pq[j]) depend(in: rho[cur]) depend(out: alpha[cur])
+		{
+			floatType dot_pq = 0.0;
+			int j;
+			for (j = 0; j < blocks; j++)
+				dot_pq += pq[j];
+			alpha[cur] = rho[cur] / dot_pq;
+		}
+
+		/* x(k+1) = x(k) + alpha*p(k) */
+		for (blk = 0; blk < blocks; blk++) {
+#pragma omp task depend(in: alpha[cur], p[start[blk]]) depend(inout: x[start[blk]])
+			{
+				int j;
+				for (j = start[blk]; j < start[blk + 1]; j++)
+					x[j] += alpha[cur] * p[j];
+			}
+		}
+
+		/* r(k+1) = r(k) - alpha*q(k) and the parts of <r(k+1),r(k+1)> */
+		for (blk = 0; blk < blocks; blk++) {
+#pragma omp task depend(in: alpha[cur], q[start[blk]]) depend(inout: r[start[blk]]) depend(out: rr[blk])
+			{
+				int j;
+				for (j = start[blk]; j < start[blk + 1]; j++)
+					r[j] -= alpha[cur] * q[j];
+				rr[blk] = dotBlock(T, blk, r, r);
+			}
+		}
+
+		/* rho(k+1) = <r(k+1),r(k+1)>, beta = rho(k+1) / rho(k) */
+#pragma omp task depend(iterator(j = 0 : blocks), in: rr[j]) depend(in: rho[cur]) depend(out: rho[nxt], beta[cur])
+		{
+			floatType dot_rr = 0.0;
+			int j;
+			for (j = 0; j < blocks; j++)
+				dot_rr += rr[j];
+			rho[nxt] = dot_rr;
+			beta[cur] = dot_rr / rho[cur];
+		}
+
+		/* Check convergence ||r(k+1)||_2 < eps. Only rho(k+1) is
+		 * waited for, the updates of x keep running. */
+#pragma omp taskwait depend(in: rho[nxt])
+		sc->residual = sqrt(rho[nxt]) * bnrm2;
+		if (sc->verbose)
+			printf("res_%d=%e\n", iter+1, sc->residual);
+		if (sc->residual <= sc->tolerance)
+			break;
+
+		/* p(k+1) = r(k+1) + beta*p(k) */
+		for (blk = 0; blk < blocks; blk++) {
+#pragma omp task depend(in: beta[cur], r[start[blk]]) depend(inout: p[start[blk]])
+			{
+				int j;
+				for (j = start[blk]; j < start[blk + 1]; j++)
+					p[j] = r[j] + beta[cur] * p[j];
+			}
+		}
+
+		/* Save the state after every checkpointInterval iterations */
+		if (sc->checkpointFile != NULL && (iter + 1) % sc->checkpointInterval == 0) {
+#pragma omp taskwait
+			if (!tryWriteCheckpoint(sc->checkpointFile, n, x, r, p, rho[nxt], bnrm2, iter + 1)) {
+				failed = 1;
+				break;
+			}
+		}
+	}
+	/* All remaining tasks are finished at the barrier of the region */
+
+	/* The matvec tasks run concurrently to the other steps, so
+	 * their summed time is shared by all threads. */
+	for (i = 0; i < blocks; i++)
+		timeMatvec += busy[i] / threads;
+	sc->iter = iter;
+	sc->timeMatvec = timeMatvec;
+	sc->timePrecond = 0.0;
+
+	free(pq);
+	free(rr);
+	free(busy);
+
+	/* The error of a checkpoint is reported outside of the region */
+	if (failed)
+		fatalError();
+}
+
+#else
+
+/* Without OpenMP 5.0 the blocks are solved as one ELLPACK-R matrix */
+void taskCg(const struct TaskMatrix* T, const floatType* b, floatType* x, struct SolverConfig* sc, struct Workspace* ws){
+	struct Operator* A;
+
+	A = createEllOperator(T->n, T->nnz, T->maxNNZ, T->data, T->indices, T->length);
+	cg(A, NULL, b, x, sc, ws);
+	destroyOperator(A);
+}
+
+#endif
@@ -0,0 +1,55 @@
+/*****************************************************
+ * CG Solver (HPC Software Lab)
+ *
+ * Parallel Programming Models for Applications in the 
+ * Area of High-Performance Computation
+ *====================================================
+ * CG as OpenMP tasks over blocks of rows
+ *****************************************************/
+
+
+
+
+#ifndef __DATAFLOW_H__
+#define __DATAFLOW_H__
+
+#include "def.h"
+#include "solver.h"
+
+/* taskCg() needs the iterators in depend clauses and the taskwait
+ * with dependencies of OpenMP 5.0. GCC has both since version 9,
+ * but still reports OpenMP 4.5. Older compilers only build a stub,
+ * which runs cg(). */
+#if defined(_OPENMP) && (_OPENMP >= 201811 || (defined(__GNUC__) && !defined(__clang__) && !defined(__INTEL_COMPILER) && __GNUC__ >= 9))
+# define HAVE_TASK_CG
+#endif
+
+/* An ELLPACK-R matrix split into blocks of consecutive rows for
+ * taskCg(). Block b holds the rows start[b] ... start[b+1]-1 and
+ * only uses the x entries of the blocks lo[b] ... hi[b]. The
+ * arrays data, indices and length are not copied. */
+struct TaskMatrix {
+	int n;
+	offsetType nnz;
+	int maxNNZ;
+	const floatType* data;
+	const int* indices;
+	const int* length;
+	int blocks;
+	int* start;
+	int* lo;
+	int* hi;
+	char name[64];
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+struct TaskMatrix* createTaskMatrix(const int n, const offsetType nnz, const int maxNNZ, const floatType* data, const int* indices, const int* length, const int blocks);
+void destroyTaskMatrix(struct TaskMatrix* T);
+void taskCg(const struct TaskMatrix* T, const floatType* b, floatType* x, struct SolverConfig* sc, struct Workspace* ws);
+#ifdef __cplusplus
+}
+#endif
+
+#endif
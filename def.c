@@ -13,6 +13,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 #ifdef _OPENACC
@@ -30,6 +31,7 @@
 #endif
 
 #include "def.h"
+#include "solver.h"
 
 /* Initialize the config with the default values.
  * During the runtime you can change these default
@@ -37,9 +39,36 @@
  * $ CG_TOLERANCE=1e-12 CG_MAX_ITER=5000 ./cg_ser a.mtx */
 struct config config = {
 	.maxIter = 1000,
-	.tolerance = 0.0000001
+	.tolerance = 0.0000001,
+	.outputFormat = OUTPUT_TEXT,
+	.outputFile = "x.out",
+	.hugePages = HUGEPAGES_NONE,
+	.initialGuess = NULL,
+	.checkpointFile = NULL,
+	.checkpointInterval = 500,
+	.restartFile = NULL,
+	.partition = 0,
+	.numaDomains = 0,
+	.kernel = KERNEL_AUTO,
+	.specialize = 1,
+	.format = FORMAT_ELL,
+	.prefetch = 0,
+	.panel = 0,
+	.stencilCoeff = NULL,
+	.precond = PRECOND_NONE,
+	.omega = 1.0,
+	.degree = 4,
+	.smoother = SMOOTHER_JACOBI,
+	.deflate = 0,
+	.deflateWindow = 0,
+	.tasks = 0,
+	.schedule = SCHEDULE_STATIC,
+	.reproducible = 0,
+	.verbose = 1
 };
 
+void (*errorHandler)(void) = NULL;
+
 /* This init function overwrites the default values,
  * if the corresponding environment variable is set. 
  * Furthermore, a GPU warmup is done.*/
@@ -51,10 +80,189 @@ void init(){
 
 	if ((tmp = getenv("CG_TOLERANCE")) != NULL)
 		config.tolerance = strtod(tmp, NULL);
+
+	if ((tmp = getenv("CG_OUTPUT")) != NULL) {
+		if (!strcmp(tmp, "text"))
+			config.outputFormat = OUTPUT_TEXT;
+		else if (!strcmp(tmp, "binary"))
+			config.outputFormat = OUTPUT_BINARY;
+		else if (!strcmp(tmp, "none"))
+			config.outputFormat = OUTPUT_NONE;
+		else {
+			printf("ERROR: Unknown CG_OUTPUT \"%s\" (use text, binary or none)!\n", tmp);
+			fatalError();
+		}
+	}
+
+	if ((tmp = getenv("CG_OUTPUT_FILE")) != NULL)
+		config.outputFile = tmp;
+
+	if ((tmp = getenv("CG_HUGEPAGES")) != NULL) {
+		if (!strcmp(tmp, "none"))
+			config.hugePages = HUGEPAGES_NONE;
+		else if (!strcmp(tmp, "thp"))
+			config.hugePages = HUGEPAGES_THP;
+		else if (!strcmp(tmp, "hugetlb"))
+			config.hugePages = HUGEPAGES_HUGETLB;
+		else {
+			printf("ERROR: Unknown CG_HUGEPAGES \"%s\" (use none, thp or hugetlb)!\n", tmp);
+			fatalError();
+		}
+	}
+
+	if ((tmp = getenv("CG_X0")) != NULL)
+		config.initialGuess = tmp;
+
+	if ((tmp = getenv("CG_CHECKPOINT")) != NULL)
+		config.checkpointFile = tmp;
+
+	if ((tmp = getenv("CG_CHECKPOINT_INTERVAL")) != NULL)
+		config.checkpointInterval = atoi(tmp);
+
+	if (config.checkpointInterval < 1) {
+		printf("ERROR: CG_CHECKPOINT_INTERVAL must be at least 1!\n");
+		fatalError();
+	}
+
+	if ((tmp = getenv("CG_RESTART")) != NULL)
+		config.restartFile = tmp;
+
+	if ((tmp = getenv("CG_PARTITION")) != NULL)
+		config.partition = atoi(tmp);
+
+	if ((tmp = getenv("CG_NUMA_DOMAINS")) != NULL)
+		config.numaDomains = atoi(tmp);
+
+	if ((tmp = getenv("CG_KERNEL")) != NULL) {
+		if (!strcmp(tmp, "auto"))
+			config.kernel = KERNEL_AUTO;
+		else if (!strcmp(tmp, "scalar"))
+			config.kernel = KERNEL_SCALAR;
+		else if (!strcmp(tmp, "avx2"))
+			config.kernel = KERNEL_AVX2;
+		else if (!strcmp(tmp, "avx512"))
+			config.kernel = KERNEL_AVX512;
+		else {
+			printf("ERROR: Unknown CG_KERNEL \"%s\" (use auto, scalar, avx2 or avx512)!\n", tmp);
+			fatalError();
+		}
+	}
+
+	if ((tmp = getenv("CG_SPECIALIZE")) != NULL)
+		config.specialize = atoi(tmp);
+
+	if ((tmp = getenv("CG_FORMAT")) != NULL) {
+		if (!strcmp(tmp, "ell"))
+			config.format = FORMAT_ELL;
+		else if (!strcmp(tmp, "bucket"))
+			config.format = FORMAT_BUCKET;
+		else if (!strcmp(tmp, "blocked"))
+			config.format = FORMAT_BLOCKED;
+		else if (!strcmp(tmp, "split"))
+			config.format = FORMAT_SPLIT;
+		else if (!strcmp(tmp, "dict"))
+			config.format = FORMAT_DICT;
+		else if (!strcmp(tmp, "packed"))
+			config.format = FORMAT_PACKED;
+		else {
+			printf("ERROR: Unknown CG_FORMAT \"%s\" (use ell, bucket, blocked, split, dict or packed)!\n", tmp);
+			fatalError();
+		}
+	}
+
+	if ((tmp = getenv("CG_PREFETCH")) != NULL)
+		config.prefetch = strcmp(tmp, "auto") ? atoi(tmp) : -1;
+
+	if ((tmp = getenv("CG_PANEL")) != NULL)
+		config.panel = atoi(tmp);
+
+	if ((tmp = getenv("CG_STENCIL_COEFF")) != NULL)
+		config.stencilCoeff = tmp;
+
+	if ((tmp = getenv("CG_PRECOND")) != NULL) {
+		if (!strcmp(tmp, "none"))
+			config.precond = PRECOND_NONE;
+		else if (!strcmp(tmp, "jacobi"))
+			config.precond = PRECOND_JACOBI;
+		else if (!strcmp(tmp, "ssor"))
+			config.precond = PRECOND_SSOR;
+		else if (!strcmp(tmp, "chebyshev"))
+			config.precond = PRECOND_CHEBYSHEV;
+		else if (!strcmp(tmp, "amg"))
+			config.precond = PRECOND_AMG;
+		else {
+			printf("ERROR: Unknown CG_PRECOND \"%s\" (use none, jacobi, ssor, chebyshev or amg)!\n", tmp);
+			fatalError();
+		}
+	}
+
+	if ((tmp = getenv("CG_OMEGA")) != NULL) {
+		config.omega = atof(tmp);
+		if (config.omega <= 0.0 || config.omega >= 2.0) {
+			printf("ERROR: CG_OMEGA must be between 0 and 2!\n");
+			fatalError();
+		}
+	}
+
+	if ((tmp = getenv("CG_DEGREE")) != NULL) {
+		config.degree = atoi(tmp);
+		if (config.degree < 1) {
+			printf("ERROR: CG_DEGREE must be at least 1!\n");
+			fatalError();
+		}
+	}
+
+	if ((tmp = getenv("CG_SMOOTHER")) != NULL) {
+		if (!strcmp(tmp, "jacobi"))
+			config.smoother = SMOOTHER_JACOBI;
+		else if (!strcmp(tmp, "chebyshev"))
+			config.smoother = SMOOTHER_CHEBYSHEV;
+		else {
+			printf("ERROR: Unknown CG_SMOOTHER \"%s\" (use jacobi or chebyshev)!\n", tmp);
+			fatalError();
+		}
+	}
+
+	if ((tmp = getenv("CG_DEFLATE")) != NULL)
+		config.deflate = atoi(tmp);
+
+	if ((tmp = getenv("CG_DEFLATE_WINDOW")) != NULL)
+		config.deflateWindow = atoi(tmp);
+
+	if ((tmp = getenv("CG_TASKS")) != NULL)
+		config.tasks = atoi(tmp);
+
+	if ((tmp = getenv("CG_SCHEDULE")) != NULL) {
+		if (!strcmp(tmp, "static"))
+			config.schedule = SCHEDULE_STATIC;
+		else if (!strcmp(tmp, "steal"))
+			config.schedule = SCHEDULE_STEAL;
+		else {
+			printf("ERROR: Unknown CG_SCHEDULE \"%s\" (use static or steal)!\n", tmp);
+			fatalError();
+		}
+	}
+
+	if ((tmp = getenv("CG_REPRODUCIBLE")) != NULL) {
+		config.reproducible = atoi(tmp);
+		if (config.reproducible < 0 || config.reproducible > 2) {
+			printf("ERROR: CG_REPRODUCIBLE must be 0, 1 or 2!\n");
+			fatalError();
+		}
+	}
+
+	selectKernels();
 	
 	gpuWarmup();
 }
 
+/* Stop after an error, which was printed before */
+void fatalError(void){
+	if (errorHandler != NULL)
+		errorHandler();
+	exit(1);
+}
+
 /* Use is time function to get the real time */
 double getWTime() {
 #if defined(_WIN32) || defined(_WIN64)
@@ -72,7 +280,7 @@ double getWTime() {
 		    0, NULL);
 		printf("QueryPerformanceCounter() failed with error %d: %s\n",
 		    err, buf);
-		exit(1);
+		fatalError();
 	}
 
 	if (QueryPerformanceFrequency(&freq) == 0)
@@ -85,7 +293,7 @@ double getWTime() {
 		    0, NULL);
 		printf("QueryPerformanceFrequency() failed with error %d: %s\n",
 		    err, buf);
-		exit(1);
+		fatalError();
 	}
 
 	dtime = Li2Double(time);
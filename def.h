@@ -37,11 +37,101 @@
 /* Define floatType as double */
 typedef double floatType;
 
+/* Define offsetType as the type of the number of non zeros and of
+ * positions in the ELLPACK-R arrays (j * n + i). Build with
+ * "make large=1" for matrices with more than 2^31 stored elements.
+ * Row and column indices always stay 32 bit to save bandwidth. */
+#ifdef LARGE_INDEX
+typedef long long offsetType;
+# define OFFSET_MAX 9223372036854775807LL
+#else
+typedef int offsetType;
+# define OFFSET_MAX 2147483647
+#endif
+
+/* Formats in which the solution vector can be written */
+enum OutputFormat {
+	OUTPUT_NONE,
+	OUTPUT_TEXT,
+	OUTPUT_BINARY
+};
+
+/* Page sizes used for the large arrays of the matrix and vectors */
+enum HugePages {
+	HUGEPAGES_NONE,
+	HUGEPAGES_THP,
+	HUGEPAGES_HUGETLB
+};
+
+/* Implementations of the kernels, see selectKernels() */
+enum Kernel {
+	KERNEL_AUTO,
+	KERNEL_SCALAR,
+	KERNEL_AVX2,
+	KERNEL_AVX512
+};
+
+/* Storage formats of the matrix, see createOperator() */
+enum Format {
+	FORMAT_ELL,
+	FORMAT_BUCKET,
+	FORMAT_BLOCKED,
+	FORMAT_SPLIT,
+	FORMAT_DICT,
+	FORMAT_PACKED
+};
+
+/* Schedules of the matvec and preconditioner loops, see steal.h */
+enum Schedule {
+	SCHEDULE_STATIC,
+	SCHEDULE_STEAL
+};
+
+/* Preconditioners of cg(), see createPreconditioner() */
+enum Precond {
+	PRECOND_NONE,
+	PRECOND_JACOBI,
+	PRECOND_SSOR,
+	PRECOND_CHEBYSHEV,
+	PRECOND_AMG
+};
+
+/* Smoothers of the AMG levels, see amg.c */
+enum Smoother {
+	SMOOTHER_JACOBI,
+	SMOOTHER_CHEBYSHEV
+};
+
 /* This structure is to used to configure 
  * the parameters for the CG algorithm */
 extern struct config {
 	int maxIter;
 	floatType tolerance;
+	enum OutputFormat outputFormat;
+	const char *outputFile;
+	enum HugePages hugePages;
+	const char *initialGuess;
+	const char *checkpointFile;
+	int checkpointInterval;
+	const char *restartFile;
+	int partition;
+	int numaDomains;
+	enum Kernel kernel;
+	int specialize;
+	enum Format format;
+	int prefetch;
+	int panel;
+	const char *stencilCoeff;
+	enum Precond precond;
+	floatType omega;
+	int degree;
+	enum Smoother smoother;
+	int deflate;
+	int deflateWindow;
+	int tasks;
+	enum Schedule schedule;
+	int reproducible;
+	int verbose;
 } config;
 
 
@@ -53,10 +143,22 @@ struct SolverConfig {
 	int maxIter;
 	floatType residual;
 	floatType timeMatvec;
+	floatType timePrecond;
+	int verbose;
+	const char *checkpointFile;
+	int checkpointInterval;
+	const char *restartFile;
+	floatType *alphas, *betas;
 };
 
 extern void init(void);
 extern double getWTime(void);
+
+/* Called after an error message instead of exit(1). The program
+ * exits, unless errorHandler is set and does not return: the
+ * library jumps back to its entry point from there (see cglib.c). */
+extern void (*errorHandler)(void);
+extern void fatalError(void);
 void gpuWarmup();
 
 #endif
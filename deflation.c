@@ -0,0 +1,367 @@
+/*****************************************************
+ * CG Solver (HPC Software Lab)
+ *
+ * Parallel Programming Models for Applications in the 
+ * Area of High-Performance Computation
+ *====================================================
+ * Deflation space of cg() kept between solves
+ *****************************************************/
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef _OPENMP
+# include <omp.h>
+#else
+# define omp_get_thread_num() 0
+#endif
+
+#include "deflation.h"
+#include "solver.h"
+#include "alloc.h"
+
+/* Lanczos vectors kept per solve for k deflation vectors, unless
+ * CG_DEFLATE_WINDOW sets another number. Ritz vectors of fewer
+ * Lanczos steps are too inaccurate and slow the next solves down.
+ * The update needs room for the k Ritz vectors and the products of
+ * up to 2k basis vectors with A in V. */
+#define DEFLATION_WINDOW(k) (12 * (k) + 40)
+#define DEFLATION_WINDOW_MIN(k) (3 * (k))
+
+/* Basis vectors with a smaller part of the largest singular value
+ * are dropped as linearly dependent */
+#define DEFLATION_DROP 1e-10
+
+/* Sweeps of the Jacobi eigenvalue algorithm */
+#define JACOBI_SWEEPS 50
+
+/* Eigenvalues val and eigenvectors (the columns of vec) of the
+ * symmetric m x m matrix a with the cyclic Jacobi algorithm. a is
+ * destroyed, the eigenvalues are sorted in ascending order. */
+static void symmetricEigen(const int m, floatType* a, floatType* vec, floatType* val){
+	floatType off, theta, t, c, s, x, y;
+	int i, j, l, sweep;
+
+	for (i = 0; i < m; i++)
+		for (j = 0; j < m; j++)
+			vec[i * m + j] = (i == j) ? 1.0 : 0.0;
+
+	for (sweep = 0; sweep < JACOBI_SWEEPS; sweep++) {
+		off = 0.0;
+		for (i = 0; i < m; i++)
+			for (j = i + 1; j < m; j++)
+				off += a[i * m + j] * a[i * m + j];
+		if (off < 1e-30)
+			break;
+
+		for (i = 0; i < m; i++) {
+			for (j = i + 1; j < m; j++) {
+				if (a[i * m + j] == 0.0)
+					continue;
+				/* Rotation which zeroes a(i,j) */
+				theta = (a[j * m + j] - a[i * m + i]) / (2.0 * a[i * m + j]);
+				t = (theta >= 0.0 ? 1.0 : -1.0) / (fabs(theta) + sqrt(theta * theta + 1.0));
+				c = 1.0 / sqrt(t * t + 1.0);
+				s = t * c;
+				for (l = 0; l < m; l++) {
+					x = a[l * m + i];
+					y = a[l * m + j];
+					a[l * m + i] = c * x - s * y;
+					a[l * m + j] = s * x + c * y;
+				}
+				for (l = 0; l < m; l++) {
+					x = a[i * m + l];
+					y = a[j * m + l];
+					a[i * m + l] = c * x - s * y;
+					a[j * m + l] = s * x + c * y;
+				}
+				for (l = 0; l < m; l++) {
+					x = vec[l * m + i];
+					y = vec[l * m + j];
+					vec[l * m + i] = c * x - s * y;
+					vec[l * m + j] = s * x + c * y;
+				}
+			}
+		}
+	}
+
+	for (i = 0; i < m; i++)
+		val[i] = a[i * m + i];
+
+	/* Selection sort of the eigenpairs */
+	for (i = 0; i < m; i++) {
+		l = i;
+		for (j = i + 1; j < m; j++)
+			if (val[j] < val[l])
+				l = j;
+		if (l == i)
+			continue;
+		x = val[i];
+		val[i] = val[l];
+		val[l] = x;
+		for (j = 0; j < m; j++) {
+			x = vec[j * m + i];
+			vec[j * m + i] = vec[j * m + l];
+			vec[j * m + l] = x;
+		}
+	}
+}
+
+/* G(a,b) = <X_a, Y_b> for all columns of X and Y in one pass */
+static void gram(const int n, floatType** X, const int kx, floatType** Y, const int ky, floatType* G){
+	int i, a, b;
+
+	for (a = 0; a < kx * ky; a++)
+		G[a] = 0.0;
+#pragma omp parallel for num_threads(threads) private(i, a, b) reduction(+:G[:kx * ky])
+	for (i = 0; i < n; i++) {
+		for (a = 0; a < kx; a++)
+			for (b = 0; b < ky; b++)
+				G[a * ky + b] += X[a][i] * Y[b][i];
+	}
+}
+
+/* out_b <- sum_a in_a * C(a,b) for b < kout. Every row is
+ * transformed on its own in the row of the thread in D->rows, so
+ * out may be the same vectors as in. kin must not exceed D->width. */
+static void transform(const struct Deflation* D, floatType** in, const int kin, const floatType* C, floatType** out, const int kout){
+	const int n = D->n;
+
+#pragma omp parallel num_threads(D->threads)
+	{
+		floatType* row = D->rows + (size_t)omp_get_thread_num() * D->width;
+		floatType sum;
+		int i, a, b;
+
+#pragma omp for
+		for (i = 0; i < n; i++) {
+			for (a = 0; a < kin; a++)
+				row[a] = in[a][i];
+			for (b = 0; b < kout; b++) {
+				sum = 0.0;
+				for (a = 0; a < kin; a++)
+					sum += row[a] * C[a * kout + b];
+				out[b][i] = sum;
+			}
+		}
+	}
+}
+
+/* mu <- lambda^-1 * X^T * y for the count deflation vectors */
+static void project(const struct Deflation* D, floatType** X, const floatType* y, floatType* mu){
+	const int k = D->count;
+	int i, a;
+
+	for (a = 0; a < k; a++)
+		mu[a] = 0.0;
+#pragma omp parallel for num_threads(threads) private(i, a) reduction(+:mu[:k])
+	for (i = 0; i < D->n; i++) {
+		for (a = 0; a < k; a++)
+			mu[a] += X[a][i] * y[i];
+	}
+	for (a = 0; a < k; a++)
+		mu[a] /= D->lambda[a];
+}
+
+/* Allocate a deflation space for up to k vectors of dimension n,
+ * which starts empty. Every solve keeps its first m Lanczos vectors,
+ * the default window if m is 0. */
+struct Deflation* createDeflation(const int n, const int k, const int m){
+	struct Deflation* D;
+	size_t perLine = ALIGNMENT / sizeof(floatType);
+	size_t square;
+	int a, columns;
+
+	D = (struct Deflation*)malloc(sizeof(struct Deflation));
+	if (D == NULL) {
+		puts("Out of memory!");
+		fatalError();
+	}
+	D->n = n;
+	D->k = k;
+	D->m = (m > 0) ? m : DEFLATION_WINDOW(k);
+	if (D->m < DEFLATION_WINDOW_MIN(k))
+		D->m = DEFLATION_WINDOW_MIN(k);
+	D->count = 0;
+	D->vectors = D->steps = 0;
+
+	/* W, AW and V in one block, every vector on its own cache lines */
+	columns = 2 * k + D->m;
+	D->stride = (n + perLine - 1) / perLine * perLine;
+	D->base = (floatType*)allocLarge(columns * D->stride * sizeof(floatType));
+	D->W = (floatType**)malloc(sizeof(floatType*) * columns);
+	D->lambda = (floatType*)malloc(sizeof(floatType) * k);
+	D->mu = (floatType*)malloc(sizeof(floatType) * k);
+	D->alphas = (floatType*)malloc(sizeof(floatType) * D->m);
+	D->betas = (floatType*)malloc(sizeof(floatType) * D->m);
+
+	/* Scratch space of deflateUpdate(): the Lanczos matrix of up to m
+	 * steps and the Gram matrices of up to 2k basis vectors */
+	square = (size_t)D->m * D->m + 4 * (size_t)k * k;
+	D->T = (floatType*)malloc(sizeof(floatType) * square);
+	D->Y = (floatType*)malloc(sizeof(floatType) * square);
+	D->C = (floatType*)malloc(sizeof(floatType) * square);
+	D->theta = (floatType*)malloc(sizeof(floatType) * (D->m + 2 * k));
+	D->S = (floatType**)malloc(sizeof(floatType*) * 4 * k);
+	D->threads = threads;
+	D->width = (D->m > 2 * k) ? D->m : 2 * k;
+	D->rows = (floatType*)malloc(sizeof(floatType) * (size_t)D->threads * D->width);
+	if (D->W == NULL || D->lambda == NULL || D->mu == NULL || D->alphas == NULL || D->betas == NULL
+	    || D->T == NULL || D->Y == NULL || D->C == NULL || D->theta == NULL || D->S == NULL || D->rows == NULL) {
+		puts("Out of memory!");
+		fatalError();
+	}
+	for (a = 0; a < columns; a++)
+		D->W[a] = D->base + a * D->stride;
+	D->AW = D->W + k;
+	D->V = D->W + 2 * k;
+
+	return D;
+}
+
+void destroyDeflation(struct Deflation* D){
+	freeLarge(D->base);
+	free(D->W);
+	free(D->lambda);
+	free(D->mu);
+	free(D->alphas);
+	free(D->betas);
+	free(D->T);
+	free(D->Y);
+	free(D->C);
+	free(D->theta);
+	free(D->S);
+	free(D->rows);
+	free(D);
+}
+
+/* Move the initial guess so that the residual is orthogonal to W:
+ *   mu = lambda^-1 * W^T * r, x <- x + W*mu, r <- r - AW*mu */
+void deflateStart(const struct Deflation* D, floatType* x, floatType* r){
+	floatType* mu = D->mu;
+	int i, a;
+
+	if (D->count == 0)
+		return;
+	project(D, D->W, r, mu);
+#pragma omp parallel for num_threads(threads) private(i, a)
+	for (i = 0; i < D->n; i++) {
+		for (a = 0; a < D->count; a++) {
+			x[i] += mu[a] * D->W[a][i];
+			r[i] -= mu[a] * D->AW[a][i];
+		}
+	}
+}
+
+/* Make the search direction A-orthogonal to W:
+ *   mu = lambda^-1 * AW^T * z, p <- p - W*mu */
+void deflateDirection(const struct Deflation* D, const floatType* z, floatType* p){
+	floatType* mu = D->mu;
+	int i, a;
+
+	if (D->count == 0)
+		return;
+	project(D, D->AW, z, mu);
+#pragma omp parallel for num_threads(threads) private(i, a)
+	for (i = 0; i < D->n; i++) {
+		for (a = 0; a < D->count; a++)
+			p[i] -= mu[a] * D->W[a][i];
+	}
+}
+
+/* Keep the j-th Lanczos vector (-1)^j * z / sqrt(rho) of the solve
+ * with rho = <r,z>, if it fits into the window */
+void deflateRecord(struct Deflation* D, const int j, const floatType* z, const floatType rho){
+	const floatType scale = ((j % 2) ? -1.0 : 1.0) / sqrt(rho);
+	int i;
+
+	if (j >= D->m)
+		return;
+#pragma omp parallel for num_threads(threads) private(i)
+	for (i = 0; i < D->n; i++) {
+		D->V[j][i] = scale * z[i];
+	}
+	D->vectors = j + 1;
+}
+
+/* Refine W with the Lanczos vectors of the last solve:
+ *  1. The Ritz vectors U of the k smallest eigenvalues of the
+ *     Lanczos matrix T of the solve.
+ *  2. An orthonormal basis S of [W, U].
+ *  3. The Rayleigh-Ritz approximation with S^T*A*S, whose k
+ *     smallest eigenpairs are the new W and lambda.
+ * This costs one matvec per basis vector. */
+void deflateUpdate(struct Deflation* D, const struct Operator* A){
+	const int n = D->n;
+	const int mm = D->vectors < D->steps ? D->vectors : D->steps;
+	floatType *T = D->T, *Y = D->Y, *C = D->C, *theta = D->theta;
+	floatType **S = D->S, **AS = D->S + 2 * D->k;
+	int i, a, b, ku, ks, kk;
+
+	D->vectors = D->steps = 0;
+	if (mm == 0)
+		return;
+
+	for (i = 0; i < mm * mm; i++)
+		T[i] = 0.0;
+
+	/* 1. T(j,j) = 1/alpha(j) + beta(j-1)/alpha(j-1),
+	 *    T(j,j+1) = sqrt(beta(j))/alpha(j) */
+	for (i = 0; i < mm; i++) {
+		T[i * mm + i] = 1.0 / D->alphas[i] + (i > 0 ? D->betas[i - 1] / D->alphas[i - 1] : 0.0);
+		if (i < mm - 1)
+			T[i * mm + i + 1] = T[(i + 1) * mm + i] = sqrt(D->betas[i]) / D->alphas[i];
+	}
+	symmetricEigen(mm, T, Y, theta);
+	ku = mm < D->k ? mm : D->k;
+	for (a = 0; a < mm; a++)
+		for (b = 0; b < ku; b++)
+			C[a * ku + b] = Y[a * mm + b];
+	transform(D, D->V, mm, C, D->V, ku);
+
+	/* 2. S = [W, U] * Q * D^-1/2 with S^T*S = Q * D * Q^T */
+	ks = 0;
+	for (a = 0; a < D->count; a++)
+		S[ks++] = D->W[a];
+	for (a = 0; a < ku; a++)
+		S[ks++] = D->V[a];
+	gram(n, S, ks, S, ks, T);
+	symmetricEigen(ks, T, Y, theta);
+	kk = 0;
+	for (b = ks - 1; b >= 0; b--) {
+		if (theta[b] <= DEFLATION_DROP * theta[ks - 1])
+			break;
+		for (a = 0; a < ks; a++)
+			C[a * ks + kk] = Y[a * ks + b] / sqrt(theta[b]);
+		kk++;
+	}
+	/* C has ks columns, of which the first kk are used */
+	for (a = 0; a < ks; a++)
+		for (b = 0; b < kk; b++)
+			Y[a * kk + b] = C[a * ks + b];
+	transform(D, S, ks, Y, S, kk);
+
+	/* 3. S^T*A*S, the products are stored behind U in V */
+	for (a = 0; a < kk; a++) {
+		AS[a] = D->V[D->k + a];
+		A->apply(A, S[a], AS[a]);
+	}
+	gram(n, S, kk, AS, kk, T);
+	for (a = 0; a < kk; a++)
+		for (b = 0; b < a; b++)
+			T[a * kk + b] = T[b * kk + a] = 0.5 * (T[a * kk + b] + T[b * kk + a]);
+	symmetricEigen(kk, T, Y, theta);
+
+	D->count = kk < D->k ? kk : D->k;
+	for (a = 0; a < kk; a++)
+		for (b = 0; b < D->count; b++)
+			C[a * D->count + b] = Y[a * kk + b];
+	transform(D, S, kk, C, D->W, D->count);
+	transform(D, AS, kk, C, D->AW, D->count);
+	for (a = 0; a < D->count; a++)
+		D->lambda[a] = theta[a];
+}
@@ -0,0 +1,57 @@
+/*****************************************************
+ * CG Solver (HPC Software Lab)
+ *
+ * Parallel Programming Models for Applications in the 
+ * Area of High-Performance Computation
+ *====================================================
+ * Deflation space of cg() kept between solves
+ *****************************************************/
+
+
+#ifndef __DEFLATION_H__
+#define __DEFLATION_H__
+
+#include <stddef.h>
+
+#include "def.h"
+
+struct Operator;
+
+/* Deflation space of cg() for a sequence of systems with the same
+ * or a slowly changing matrix. W holds count approximate
+ * eigenvectors of the smallest eigenvalues of A, AW their products
+ * with A and lambda = W^T*A*W, which is diagonal. mu is scratch
+ * space for the projections. During a solve V
+ * collects the Lanczos vectors and alphas, betas the coefficients
+ * of the first m iterations, which refine W after the solve. T, Y,
+ * C, theta and S are the scratch space of the update, rows holds
+ * one row of width columns for each of the threads. */
+struct Deflation {
+	int n, k, m;
+	int count;
+	int vectors, steps;
+	size_t stride;
+	floatType* base;
+	floatType **W, **AW, **V;
+	floatType *lambda, *mu;
+	floatType *alphas, *betas;
+	floatType *T, *Y, *C, *theta;
+	floatType **S;
+	int threads, width;
+	floatType* rows;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+struct Deflation* createDeflation(const int n, const int k, const int m);
+void destroyDeflation(struct Deflation* D);
+void deflateStart(const struct Deflation* D, floatType* x, floatType* r);
+void deflateDirection(const struct Deflation* D, const floatType* z, floatType* p);
+void deflateRecord(struct Deflation* D, const int j, const floatType* z, const floatType rho);
+void deflateUpdate(struct Deflation* D, const struct Operator* A);
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,171 @@
+/*****************************************************
+ * CG Solver (HPC Software Lab)
+ *
+ * Parallel Programming Models for Applications in the 
+ * Area of High-Performance Computation
+ *====================================================
+ * Operator with dictionary coded values
+ *****************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "dict.h"
+#include "alloc.h"
+#include "io.h"
+
+/* Most distinct values a dictionary can hold (16 bit codes) */
+#define DICT_MAX 65536
+
+/* Slots of the hash table used to find the distinct values */
+#define DICT_HASH_BITS 17
+#define DICT_HASH_SIZE (1 << DICT_HASH_BITS)
+
+/* The matrix in ELLPACK-R format with every value replaced by its
+ * position in the table values. codes8 is used for up to 256
+ * distinct values, codes16 otherwise. */
+struct DictState {
+	int maxNNZ;
+	int distinct;
+	floatType* values;
+	uint8_t* codes8;
+	uint16_t* codes16;
+	int* indices;
+	int* length;
+};
+
+/* y <- A*x with B bit codes. The value table stays in the L1 or L2
+ * cache while the codes are streamed. */
+#define DICT_MATVEC(B) \
+static void applyDict##B(const struct Operator* A, const floatType* x, floatType* y){ \
+	const struct DictState* s = (const struct DictState*)A->state; \
+	const int n = A->n; \
+	const uint##B##_t* codes = s->codes##B; \
+	int i, j; \
+	offsetType k; \
+	floatType sum; \
+	_Pragma("omp parallel for num_threads(threads) private(i, j, k, sum)") \
+	for (i = 0; i < n; i++) { \
+		sum = 0.0; \
+		for (j = 0; j < s->length[i]; j++) { \
+			k = (offsetType)j * n + i; \
+			sum += s->values[codes[k]] * x[s->indices[k]]; \
+		} \
+		y[i] = sum; \
+	} \
+}
+
+DICT_MATVEC(8)
+DICT_MATVEC(16)
+
+static void destroyDict(struct Operator* A){
+	struct DictState* s = (struct DictState*)A->state;
+	free(s->values);
+	freeLarge(s->codes8);
+	freeLarge(s->codes16);
+	destroyMatrix(NULL, s->indices, s->length);
+	free(s);
+}
+
+/* Slot of the value v in the hash table, which is either free
+ * (-1) or holds the code of v */
+static int dictSlot(const int* table, const floatType* values, const floatType v){
+	uint64_t bits;
+	int h;
+
+	memcpy(&bits, &v, sizeof(bits));
+	h = (int)((bits * 0x9E3779B97F4A7C15ULL) >> (64 - DICT_HASH_BITS));
+	while (table[h] >= 0 && memcmp(&values[table[h]], &v, sizeof(v)))
+		h = (h + 1) & (DICT_HASH_SIZE - 1);
+	return h;
+}
+
+/* Create an operator which stores each value of the ELLPACK-R matrix
+ * as an 8 or 16 bit code into a table of the distinct values. The
+ * indices are copied. NULL is returned if the matrix has more than
+ * DICT_MAX distinct values. */
+struct Operator* createDictOperator(const int n, const offsetType nnz, const int maxNNZ, const floatType* data, const int* indices, const int* length){
+	struct Operator* A;
+	struct DictState* s;
+	int* table;
+	int i, j, h;
+	offsetType k, stored = (offsetType)maxNNZ * n;
+
+	s = (struct DictState*)malloc(sizeof(struct DictState));
+	table = (int*)malloc(sizeof(int) * DICT_HASH_SIZE);
+	if (s == NULL || table == NULL) {
+		puts("Out of memory!");
+		fatalError();
+	}
+	s->values = (floatType*)malloc(sizeof(floatType) * DICT_MAX);
+	if (s->values == NULL) {
+		puts("Out of memory!");
+		fatalError();
+	}
+
+	/* Collect the distinct values. The zero of the padding is
+	 * always the first one. */
+	for (h = 0; h < DICT_HASH_SIZE; h++)
+		table[h] = -1;
+	s->values[0] = 0.0;
+	table[dictSlot(table, s->values, 0.0)] = 0;
+	s->distinct = 1;
+	for (k = 0; k < stored; k++) {
+		h = dictSlot(table, s->values, data[k]);
+		if (table[h] < 0) {
+			if (s->distinct == DICT_MAX) {
+				free(table);
+				free(s->values);
+				free(s);
+				return NULL;
+			}
+			s->values[s->distinct] = data[k];
+			table[h] = s->distinct++;
+		}
+	}
+
+	/* Replace the values by their codes */
+	s->codes8 = NULL;
+	s->codes16 = NULL;
+	if (s->distinct <= 256)
+		s->codes8 = (uint8_t*)allocLarge(sizeof(uint8_t) * stored);
+	else
+		s->codes16 = (uint16_t*)allocLarge(sizeof(uint16_t) * stored);
+	for (k = 0; k < stored; k++) {
+		h = table[dictSlot(table, s->values, data[k])];
+		if (s->codes8 != NULL)
+			s->codes8[k] = (uint8_t)h;
+		else
+			s->codes16[k] = (uint16_t)h;
+	}
+	free(table);
+
+	s->maxNNZ = maxNNZ;
+	s->indices = (int*)allocLarge(sizeof(int) * stored);
+	s->length = (int*)allocLarge(sizeof(int) * n);
+#pragma omp parallel for num_threads(threads) private(i, j, k)
+	for (i = 0; i < n; i++) {
+		s->length[i] = length[i];
+		for (j = 0; j < maxNNZ; j++) {
+			k = (offsetType)j * n + i;
+			s->indices[k] = indices[k];
+		}
+	}
+
+	A = (struct Operator*)malloc(sizeof(struct Operator));
+	if (A == NULL) {
+		puts("Out of memory!");
+		fatalError();
+	}
+	snprintf(A->format, sizeof(A->format), "ELLPACK-R, %d bit codes for %d values", s->codes8 != NULL ? 8 : 16, s->distinct);
+	A->n = n;
+	A->nnz = nnz;
+	A->diag = NULL;
+	A->apply = s->codes8 != NULL ? applyDict8 : applyDict16;
+	A->destroy = destroyDict;
+	A->state = s;
+	return A;
+}
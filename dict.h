@@ -0,0 +1,25 @@
+/*****************************************************
+ * CG Solver (HPC Software Lab)
+ *
+ * Parallel Programming Models for Applications in the 
+ * Area of High-Performance Computation
+ *====================================================
+ * Operator with dictionary coded values
+ *****************************************************/
+
+
+#ifndef __DICT_H__
+#define __DICT_H__
+
+#include "def.h"
+#include "solver.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+struct Operator* createDictOperator(const int n, const offsetType nnz, const int maxNNZ, const floatType* data, const int* indices, const int* length);
+#ifdef __cplusplus
+}
+#endif
+
+#endif
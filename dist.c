@@ -0,0 +1,434 @@
+/*****************************************************
+ * CG Solver (HPC Software Lab)
+ *
+ * Parallel Programming Models for Applications in the 
+ * Area of High-Performance Computation
+ *====================================================
+ * CG on a row-wise distributed matrix (MPI)
+ *****************************************************/
+
+
+
+#ifdef USE_MPI
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "dist.h"
+#include "io.h"
+#include "alloc.h"
+#include "errorcheck.h"
+#include "output.h"
+
+/* Compare two ints for qsort() */
+static int compareInt(const void* a, const void* b){
+	int x = *(const int*)a, y = *(const int*)b;
+	return (x > y) - (x < y);
+}
+
+/* Allocate n ints or exit */
+static int* allocInt(const size_t n){
+	int* ptr = (int*)malloc(sizeof(int) * (n > 0 ? n : 1));
+
+	if (ptr == NULL) {
+		puts("Out of memory!");
+		fatalError();
+	}
+
+	return ptr;
+}
+
+/* Read this rank's block of rows of the matrix market file
+ * "filename", find the halo and build the lists for the halo
+ * exchange with the neighbor ranks. */
+void distParseMM(char *filename, struct DistMatrix* A){
+	int rank, size, r, i, j, h, owner;
+	int *I, *J, *remote, *first, *recvCount, *sendCount, *recvDispl, *sendDispl, *request;
+	offsetType k, count;
+	floatType *V;
+
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+	readMMRows(filename, rank, size, &A->n, &A->nnz, &I, &J, &V);
+	A->first = (int)((long long)A->n * rank / size);
+	A->rows = (int)((long long)A->n * (rank + 1) / size) - A->first;
+
+	MPI_Allreduce(&A->nnz, &A->globalNnz, 1,
+	    sizeof(offsetType) == sizeof(int) ? MPI_INT : MPI_LONG_LONG,
+	    MPI_SUM, MPI_COMM_WORLD);
+
+	/* Collect the columns owned by other ranks, sorted and unique */
+	remote = allocInt(A->nnz);
+	for (count = 0, k = 0; k < A->nnz; k++) {
+		if (J[k] < A->first || J[k] >= A->first + A->rows)
+			remote[count++] = J[k];
+	}
+	qsort(remote, count, sizeof(int), compareInt);
+	for (A->halo = 0, k = 0; k < count; k++) {
+		if (A->halo == 0 || remote[A->halo - 1] != remote[k])
+			remote[A->halo++] = remote[k];
+	}
+
+	/* Count the halo entries per owner. first[r] is the first row
+	 * of rank r, first[size] = n. */
+	first = allocInt(size + 1);
+	recvCount = allocInt(size);
+	sendCount = allocInt(size);
+	recvDispl = allocInt(size);
+	sendDispl = allocInt(size);
+	for (r = 0; r <= size; r++)
+		first[r] = (int)((long long)A->n * r / size);
+	memset(recvCount, 0, sizeof(int) * size);
+	for (owner = 0, h = 0; h < A->halo; h++) {
+		while (remote[h] >= first[owner + 1])
+			owner++;
+		recvCount[owner]++;
+	}
+
+	/* Tell every owner which of its entries are needed here */
+	MPI_Alltoall(recvCount, 1, MPI_INT, sendCount, 1, MPI_INT, MPI_COMM_WORLD);
+	for (recvDispl[0] = sendDispl[0] = 0, r = 1; r < size; r++) {
+		recvDispl[r] = recvDispl[r - 1] + recvCount[r - 1];
+		sendDispl[r] = sendDispl[r - 1] + sendCount[r - 1];
+	}
+	request = allocInt(sendDispl[size - 1] + sendCount[size - 1]);
+	MPI_Alltoallv(remote, recvCount, recvDispl, MPI_INT,
+	    request, sendCount, sendDispl, MPI_INT, MPI_COMM_WORLD);
+
+	/* Keep only the ranks with something to send or receive */
+	A->neighbor = allocInt(size);
+	A->sendStart = allocInt(size + 1);
+	A->recvStart = allocInt(size + 1);
+	A->sendIndex = request;
+	A->sendStart[0] = A->recvStart[0] = 0;
+	for (A->neighbors = 0, r = 0; r < size; r++) {
+		if (recvCount[r] == 0 && sendCount[r] == 0)
+			continue;
+		A->neighbor[A->neighbors] = r;
+		A->sendStart[A->neighbors + 1] = sendDispl[r] + sendCount[r];
+		A->recvStart[A->neighbors + 1] = recvDispl[r] + recvCount[r];
+		A->neighbors++;
+	}
+	for (i = 0; i < A->sendStart[A->neighbors]; i++)
+		A->sendIndex[i] -= A->first;
+	A->sendBuf = (floatType*)allocLarge(sizeof(floatType) * (A->sendStart[A->neighbors] + 1));
+	A->requests = (MPI_Request*)malloc(sizeof(MPI_Request) * 2 * (A->neighbors + 1));
+	if (A->requests == NULL) {
+		puts("Out of memory!");
+		fatalError();
+	}
+
+	/* Switch to local row and column numbers */
+	for (k = 0; k < A->nnz; k++) {
+		I[k] -= A->first;
+		if (J[k] >= A->first && J[k] < A->first + A->rows) {
+			J[k] -= A->first;
+		} else {
+			J[k] = A->rows + (int)((int*)bsearch(&J[k], remote, A->halo, sizeof(int), compareInt) - remote);
+		}
+	}
+
+	cooToEll(A->rows, A->nnz, I, J, V, &A->maxNNZ, &A->data, &A->indices, &A->length);
+
+	/* Split into interior and boundary rows */
+	A->interiorRows = allocInt(A->rows);
+	A->boundaryRows = allocInt(A->rows);
+	A->interior = A->boundary = 0;
+	for (i = 0; i < A->rows; i++) {
+		for (j = 0; j < A->length[i]; j++) {
+			if (A->indices[(offsetType)j * A->rows + i] >= A->rows)
+				break;
+		}
+		if (j == A->length[i])
+			A->interiorRows[A->interior++] = i;
+		else
+			A->boundaryRows[A->boundary++] = i;
+	}
+
+	/* Clean up */
+	free(first);
+	free(recvCount);
+	free(sendCount);
+	free(recvDispl);
+	free(sendDispl);
+	free(remote);
+	free(I);
+	free(J);
+	free(V);
+}
+
+/* Free the local part of the distributed matrix */
+void distDestroy(struct DistMatrix* A){
+	destroyMatrix(A->data, A->indices, A->length);
+	freeLarge(A->sendBuf);
+	free(A->interiorRows);
+	free(A->boundaryRows);
+	free(A->neighbor);
+	free(A->sendStart);
+	free(A->sendIndex);
+	free(A->recvStart);
+	free(A->requests);
+}
+
+/* y <- A*x
+ * x has rows + halo entries, the halo part is received from the
+ * neighbors while the interior rows are computed. */
+void distMatvec(struct DistMatrix* A, floatType* x, floatType* y){
+	int k, i, count = 0;
+	int total = A->sendStart[A->neighbors];
+
+	/* Receive the halo directly behind the local entries of x */
+	for (k = 0; k < A->neighbors; k++) {
+		if (A->recvStart[k + 1] > A->recvStart[k])
+			MPI_Irecv(x + A->rows + A->recvStart[k], A->recvStart[k + 1] - A->recvStart[k],
+			    MPI_FLOATTYPE, A->neighbor[k], 0, MPI_COMM_WORLD, &A->requests[count++]);
+	}
+
+	/* Pack and send the entries the neighbors need */
+#pragma omp parallel for num_threads(threads) private(i)
+	for (i = 0; i < total; i++) {
+		A->sendBuf[i] = x[A->sendIndex[i]];
+	}
+	for (k = 0; k < A->neighbors; k++) {
+		if (A->sendStart[k + 1] > A->sendStart[k])
+			MPI_Isend(A->sendBuf + A->sendStart[k], A->sendStart[k + 1] - A->sendStart[k],
+			    MPI_FLOATTYPE, A->neighbor[k], 0, MPI_COMM_WORLD, &A->requests[count++]);
+	}
+
+	/* Overlap the communication with the interior rows */
+	matvecRows(A->rows, A->interiorRows, A->interior, A->data, A->indices, A->length, x, y);
+
+	MPI_Waitall(count, A->requests, MPI_STATUSES_IGNORE);
+
+	matvecRows(A->rows, A->boundaryRows, A->boundary, A->data, A->indices, A->length, x, y);
+}
+
+/* ab <- a' * b over all ranks */
+void distDot(const floatType* a, const floatType* b, const int n, floatType* ab, struct Workspace* ws){
+	floatType local;
+
+	vectorDot(a, b, n, &local, ws);
+	MPI_Allreduce(&local, ab, 1, MPI_FLOATTYPE, MPI_SUM, MPI_COMM_WORLD);
+}
+
+/* The CG algorithm of cg() on the distributed matrix. x and the
+ * workspace vectors must have room for rows + halo entries. */
+void distCg(struct DistMatrix* A, const floatType* b, floatType* x, struct SolverConfig* sc, struct Workspace* ws){
+	floatType* r = ws->r, *p = ws->p, *q = ws->q;
+	floatType alpha, beta, rho, rho_old, dot_pq, bnrm2;
+	int iter, n = A->rows;
+	double timeMatvec_s;
+	double timeMatvec=0;
+
+	/* r(0)    = b - Ax(0) */
+	timeMatvec_s = getWTime();
+	distMatvec(A, x, r);
+	timeMatvec += getWTime() - timeMatvec_s;
+	xpay(b, -1.0, n, r);
+
+	/* Normalize all residuals with ||b||_2 */
+	distDot(b, b, n, &bnrm2, ws);
+	bnrm2 = 1.0 / sqrt(bnrm2);
+
+	/* p(0)    = r(0) */
+	memcpy(p, r, n*sizeof(floatType));
+
+	/* rho(0)    =  <r(0),r(0)> */
+	distDot(r, r, n, &rho, ws);
+	if (sc->verbose)
+		printf("rho_0=%e\n", rho);
+
+	sc->residual = sqrt(rho) * bnrm2;
+
+	for(iter = 0; iter < sc->maxIter && sc->residual > sc->tolerance; iter++){
+		/* q(k)      = A * p(k) */
+		timeMatvec_s = getWTime();
+		distMatvec(A, p, q);
+		timeMatvec += getWTime() - timeMatvec_s;
+
+		/* dot_pq    = <p(k),q(k)> */
+		distDot(p, q, n, &dot_pq, ws);
+
+		/* alpha     = rho(k) / dot_pq */
+		alpha = rho / dot_pq;
+
+		/* x(k+1)    = x(k) + alpha*p(k) */
+		axpy(alpha, p, n, x);
+
+		/* r(k+1)    = r(k) - alpha*q(k) */
+		axpy(-alpha, q, n, r);
+
+		rho_old = rho;
+
+		/* rho(k+1)  = <r(k+1), r(k+1)> */
+		distDot(r, r, n, &rho, ws);
+
+		/* Check convergence ||r(k+1)||_2 < eps */
+		sc->residual= sqrt(rho) * bnrm2;
+		if (sc->verbose)
+			printf("res_%d=%e\n", iter+1, sc->residual);
+		if(sc->residual <= sc->tolerance)
+			break;
+
+		/* beta      = rho(k+1) / rho(k) */
+		beta = rho / rho_old;
+
+		/* p(k+1)    = r(k+1) + beta*p(k) */
+		xpay(r, beta, n, p);
+	}
+
+	/* The slowest rank determines the matvec time */
+	MPI_Allreduce(&timeMatvec, &sc->timeMatvec, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+	sc->timePrecond = 0.0;
+	sc->iter = iter;
+}
+
+/* ||b - A*x||_2 over all ranks, using q of ws as temporary vector */
+static floatType distResidual(struct DistMatrix* A, const floatType* b, floatType* x, struct Workspace* ws){
+	floatType* q = ws->q;
+	floatType residual;
+
+	distMatvec(A, x, q);
+	xpay(b, -1.0, A->rows, q);
+	distDot(q, q, A->rows, &residual, ws);
+
+	return sqrt(residual);
+}
+
+/* The main program for MPI runs: every rank reads and solves its
+ * block of rows, rank 0 collects the solution and prints the
+ * results. Checkpoints are not supported with MPI. */
+int distMain(int argc, char *argv[]){
+	struct DistMatrix A;
+	struct SolverConfig sc;
+	struct Workspace* ws;
+	floatType *b, *x, *xGlobal = NULL;
+	floatType residual, bnrm2;
+	int rank, size, provided, correct, i, j, r;
+	int *counts = NULL, *displs = NULL;
+	double ioTime, solveTime, outputTime, totalTime;
+
+	MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+	if (rank == 0 && (config.checkpointFile != NULL || config.restartFile != NULL))
+		printf("WARNING: Checkpoints are not supported with MPI, ignoring them.\n");
+	if (rank == 0 && config.precond != PRECOND_NONE)
+		printf("WARNING: Preconditioners are not supported with MPI, ignoring them.\n");
+
+	/* Start time measurement for the total time */
+	totalTime = getWTime();
+
+	ioTime = getWTime();
+	distParseMM(argv[1], &A);
+	ioTime = getWTime() - ioTime;
+
+	/* x and the workspace need room for the halo */
+	b = (floatType*)allocLarge(A.rows * sizeof(floatType));
+	x = (floatType*)allocLarge((A.rows + A.halo) * sizeof(floatType));
+	ws = createWorkspace(A.rows + A.halo);
+
+	/* Init the LGS as in the serial version */
+	for (i = 0; i < A.rows; i++) {
+		b[i] = 0;
+		x[i] = 0;
+		for (j = 0; j < A.length[i]; j++) {
+			b[i] += A.data[(offsetType)j * A.rows + i];
+		}
+	}
+
+	bnrm2 = distResidual(&A, b, x, ws);
+
+	/* Every rank takes its part of the initial guess */
+	if (config.initialGuess != NULL) {
+		xGlobal = (floatType*)allocLarge(A.n * sizeof(floatType));
+		readVector(config.initialGuess, xGlobal, A.n);
+		memcpy(x, xGlobal + A.first, A.rows * sizeof(floatType));
+		freeLarge(xGlobal);
+	}
+
+	/* Set the solver configuration */
+	memset(&sc, 0, sizeof(sc));
+	sc.maxIter = config.maxIter;
+	sc.tolerance = config.tolerance;
+	sc.verbose = (rank == 0);
+
+	MPI_Barrier(MPI_COMM_WORLD);
+	solveTime = getWTime();
+	distCg(&A, b, x, &sc, ws);
+	solveTime = getWTime() - solveTime;
+
+	/* Check error */
+	residual = distResidual(&A, b, x, ws);
+	correct = check_error(bnrm2, residual, sc.tolerance);
+
+	/* Collect the solution on rank 0 */
+	outputTime = getWTime();
+	if (rank == 0) {
+		xGlobal = (floatType*)allocLarge(A.n * sizeof(floatType));
+		counts = allocInt(size);
+		displs = allocInt(size);
+		for (r = 0; r < size; r++) {
+			displs[r] = (int)((long long)A.n * r / size);
+			counts[r] = (int)((long long)A.n * (r + 1) / size) - displs[r];
+		}
+	}
+	MPI_Gatherv(x, A.rows, MPI_FLOATTYPE, xGlobal, counts, displs, MPI_FLOATTYPE, 0, MPI_COMM_WORLD);
+
+	if (rank == 0) {
+		if (A.n > 10){
+			printf("First 10 values of the solution vector x = ");
+			printVector(xGlobal, 10);
+		} else {
+			printf("Solution vector x = ");
+			printVector(xGlobal, A.n);
+		}
+
+		writeVector(config.outputFile, xGlobal, A.n, config.outputFormat);
+
+		freeLarge(xGlobal);
+		free(counts);
+		free(displs);
+	}
+	outputTime = getWTime() - outputTime;
+
+	/* Clean up */
+	destroyWorkspace(ws);
+	freeLarge(b);
+	freeLarge(x);
+	distDestroy(&A);
+
+	totalTime = getWTime() - totalTime;
+
+	/* Print out some information */
+	if (rank == 0) {
+		output(
+		    argv,
+		    "NNZ", 'l', (long long)A.globalNnz,
+		    "N", 'i', A.n,
+		    "MPI ranks", 'i', size,
+		    "Max. iterations", 'i', sc.maxIter,
+		    "Tolerance", 'e', sc.tolerance,
+		    "Residual", 'e', sc.residual,
+		    "Iterations", 'i', sc.iter,
+		    "MatVec time", 'f', sc.timeMatvec,
+		    "Hotspot GFLOP/s", 'f', ((2.0 * ((double)A.globalNnz) * ((double)(sc.iter+1))) / (sc.timeMatvec * 1000000000.0)),
+		    "IO time", 'f', ioTime,
+		    "Solve time", 'f', solveTime,
+		    "Output time", 'f', outputTime,
+		    "Total time", 'f', totalTime,
+		    "RESULT CHECK", 's', correct == 0 ? "ERROR" : "OK",
+		    (const char*)NULL
+		);
+	}
+
+	MPI_Finalize();
+
+	return 0;
+}
+
+#endif
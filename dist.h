@@ -0,0 +1,77 @@
+/*****************************************************
+ * CG Solver (HPC Software Lab)
+ *
+ * Parallel Programming Models for Applications in the 
+ * Area of High-Performance Computation
+ *====================================================
+ * CG on a row-wise distributed matrix (MPI)
+ *****************************************************/
+
+
+
+#ifndef __DIST_H__
+#define __DIST_H__
+
+#include "def.h"
+#include "solver.h"
+
+#ifdef USE_MPI
+#include <mpi.h>
+
+/* MPI datatype matching floatType */
+#define MPI_FLOATTYPE MPI_DOUBLE
+
+/* The block of rows [first, first + rows) of a matrix which is
+ * distributed row-wise over all MPI ranks. The local rows are
+ * stored in ELLPACK-R format with local column numbers: columns
+ * 0 ... rows-1 are owned by this rank, columns rows ... rows+halo-1
+ * refer to the halo, the remote x entries received from the
+ * neighbor ranks. The halo is ordered by global column, and thereby
+ * by the owning rank. */
+struct DistMatrix {
+	int n;
+	int first;
+	int rows;
+	int halo;
+	offsetType nnz;
+	offsetType globalNnz;
+	int maxNNZ;
+	floatType* data;
+	int* indices;
+	int* length;
+
+	/* Rows which only use local x entries can be computed while
+	 * the halo is exchanged, the boundary rows afterwards. */
+	int interior;
+	int* interiorRows;
+	int boundary;
+	int* boundaryRows;
+
+	/* The k-th neighbor rank gets the local x entries
+	 * sendIndex[sendStart[k] ... sendStart[k+1]-1] and sends the
+	 * halo entries recvStart[k] ... recvStart[k+1]-1. */
+	int neighbors;
+	int* neighbor;
+	int* sendStart;
+	int* sendIndex;
+	int* recvStart;
+	floatType* sendBuf;
+	MPI_Request* requests;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+void distParseMM(char *filename, struct DistMatrix* A);
+void distDestroy(struct DistMatrix* A);
+void distMatvec(struct DistMatrix* A, floatType* x, floatType* y);
+void distDot(const floatType* a, const floatType* b, const int n, floatType* ab, struct Workspace* ws);
+void distCg(struct DistMatrix* A, const floatType* b, floatType* x, struct SolverConfig* sc, struct Workspace* ws);
+int distMain(int argc, char *argv[]);
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+#endif
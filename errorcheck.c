@@ -13,6 +13,7 @@
 
 
 #include "errorcheck.h"
+#include "alloc.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -25,39 +26,49 @@ int check_error(const floatType bnrm2, const floatType residual, const floatType
 }
 
 /* Calculate the current residual for error checking. You must not change this function, 
- * it is not used to during the algorithm. There is no need to parallelize it. */
-floatType get_residual(const int n, const int nnz, const int maxNNZ, const floatType* data, const int* indices, const int* length, const floatType* const b, const floatType* const x){
-	int i,j, k;
-	floatType* y;
+ * it is not used to during the algorithm. There is no need to parallelize it.
+ * The residual is accumulated row by row, so no temporary vector is needed. */
+floatType get_residual(const int n, const offsetType nnz, const int maxNNZ, const floatType* data, const int* indices, const int* length, const floatType* const b, const floatType* const x){
+	int i,j;
+	offsetType k;
+	floatType y;
 	floatType residual;
 
-	/* Allocate residual vector */
-	y = (floatType*)malloc(n * sizeof(floatType));
-
-	/* y = A * x */
+	residual = 0;
 	for (i = 0; i < n; i++) {
-		y[i] = 0;
+		/* y = A * x */
+		y = 0;
 		for (j = 0; j < length[i]; j++) {
-			k = j * n + i;
-			y[i] += data[k] * x[indices[k]];
+			k = (offsetType)j * n + i;
+			y += data[k] * x[indices[k]];
 		}
-	}
 
-	/* y = | b - y | */
-	for(i = 0; i < n; i++){
-		y[i] = fabs(b[i]-y[i]);
-	}	
+		/* y = | b - y | */
+		y = fabs(b[i]-y);
 
-	/* residual = || y ||_2 */
-	residual = 0;
-	for(i=0; i < n; i++){
-		residual += y[i] * y[i];
+		/* residual = || b - A * x ||_2 */
+		residual += y * y;
 	}
 	residual = sqrt(residual);
 
-	/* Clean up */
-	free(y);
-	
 	return residual;
 }
 
+/* Calculate the residual for a matrix which is only given as an
+ * operator, so y = A * x needs a temporary vector. */
+floatType get_operator_residual(const struct Operator* A, const floatType* const b, const floatType* const x){
+	int i;
+	floatType* y;
+	floatType residual;
+
+	y = (floatType*)allocLarge(A->n * sizeof(floatType));
+	A->apply(A, x, y);
+
+	residual = 0;
+	for (i = 0; i < A->n; i++)
+		residual += (b[i] - y[i]) * (b[i] - y[i]);
+	residual = sqrt(residual);
+
+	freeLarge(y);
+	return residual;
+}
@@ -15,6 +15,8 @@
 #define __CHECK_ERROR_H__
 
 #include "def.h"
+#include "solver.h"
 int check_error(const floatType bnrm2, const floatType residual, const floatType cg_tol);
-floatType get_residual(const int n, const int nnz, const int maxNNZ, const floatType* data, const int* indices, const int* length, const floatType* const b, const floatType* const x);
+floatType get_residual(const int n, const offsetType nnz, const int maxNNZ, const floatType* data, const int* indices, const int* length, const floatType* const b, const floatType* const x);
+floatType get_operator_residual(const struct Operator* A, const floatType* const b, const floatType* const x);
 #endif
@@ -19,13 +19,92 @@
 void help(const char *argv0) {
 	printf("Usage: %s matrix\n"
 	    "\n"
-	    "matrix has to be a matrix market (mtx) file.\n"
+	    "matrix has to be a matrix market (mtx) file, or stencil:NXxNY\n"
+	    "or stencil:NXxNYxNZ for the finite difference operator on a\n"
+	    "2D or 3D grid, which is applied without storing the matrix.\n"
 	    "\n"
 	    "Environment variables:\n"
 	    "\tCG_MAX_ITER\tMaximum number of iterations.\n"
 	    "\tCG_TOLERANCE\tAllowed tolerance after which to stop.\n"
+	    "\tCG_OUTPUT\tFormat of the solution file: text, binary or none.\n"
+	    "\tCG_OUTPUT_FILE\tName of the solution file.\n"
+	    "\tCG_HUGEPAGES\tBack matrix and vectors with 2 MiB pages:\n"
+	    "\t\t\tnone, thp (transparent) or hugetlb (reserved).\n"
+	    "\tCG_X0\t\tFile with the initial guess (text or binary).\n"
+	    "\tCG_CHECKPOINT\tFile to save the solver state in regularly.\n"
+	    "\tCG_CHECKPOINT_INTERVAL\n"
+	    "\t\t\tIterations between two checkpoints.\n"
+	    "\tCG_RESTART\tCheckpoint file to resume the solver from.\n"
+	    "\tCG_PARTITION\tRenumber the matrix into one block per NUMA\n"
+	    "\t\t\tdomain (1) or keep the order of the file (0).\n"
+	    "\tCG_NUMA_DOMAINS\tNumber of NUMA domains, detected if not set.\n"
+	    "\tCG_KERNEL\tKernel variant: auto (widest the processor\n"
+	    "\t\t\tsupports), scalar, avx2 or avx512.\n"
+	    "\tCG_SPECIALIZE\tUse a matvec kernel for a fixed row length\n"
+	    "\t\t\tif the rows are almost uniform (1) or not (0).\n"
+	    "\tCG_FORMAT\tStorage format of the matrix: ell (ELLPACK-R),\n"
+	    "\t\t\tbucket (rows grouped by their length),\n"
+	    "\t\t\tblocked (panels of columns fitting the cache),\n"
+	    "\t\t\tsplit (diagonal kept as a dense array),\n"
+	    "\t\t\tdict (8/16 bit codes for few distinct values)\n"
+	    "\t\t\tor packed (column indices as 1, 2 or 4 byte\n"
+	    "\t\t\tdistances to the row).\n"
+	    "\tCG_PREFETCH\tRows to prefetch x ahead in the ELLPACK-R\n"
+	    "\t\t\tmatvec, 0 (off) or auto (tuned at setup).\n"
+	    "\tCG_PANEL\tColumns per panel of the blocked format,\n"
+	    "\t\t\tsized to the last level cache if not set.\n"
+	    "\tCG_STENCIL_COEFF\n"
+	    "\t\t\tFile with the coefficient of every grid point\n"
+	    "\t\t\t(text or binary), constant if not set.\n"
+	    "\tCG_PRECOND\tPreconditioner: none, jacobi (diagonal),\n"
+	    "\t\t\tssor (symmetric SOR, rows of one color of a\n"
+	    "\t\t\tgraph coloring are relaxed in parallel),\n"
+	    "\t\t\tchebyshev (polynomial in A, eigenvalue bounds\n"
+	    "\t\t\tfrom a few Lanczos steps at setup) or amg\n"
+	    "\t\t\t(smoothed aggregation multigrid V-cycle).\n"
+	    "\tCG_OMEGA\tRelaxation factor of ssor, between 0 and 2.\n"
+	    "\tCG_DEGREE\tDegree of the chebyshev polynomial, which is\n"
+	    "\t\t\tthe number of matvecs per application.\n"
+	    "\tCG_SMOOTHER\tSmoother of amg: jacobi (damped) or chebyshev\n"
+	    "\t\t\t(polynomial in D^-1*A, bounded by Gershgorin).\n"
+	    "\tCG_DEFLATE\tNumber of approximate eigenvectors, which the\n"
+	    "\t\t\tlibrary (cgSolverSolve) keeps from one solve to\n"
+	    "\t\t\tdeflate the next one, 0 for none.\n"
+	    "\tCG_DEFLATE_WINDOW\n"
+	    "\t\t\tNumber of Lanczos vectors of a solve, from\n"
+	    "\t\t\twhich the eigenvectors are refined (at least\n"
+	    "\t\t\t3 * CG_DEFLATE), 12 * CG_DEFLATE + 40 if not set.\n"
+	    "\tCG_TASKS\tNumber of row blocks, for which CG runs as\n"
+	    "\t\t\tOpenMP tasks with dependencies instead of\n"
+	    "\t\t\tparallel loops, 0 for none. Several blocks per\n"
+	    "\t\t\tthread balance the load.\n"
+	    "\tCG_SCHEDULE\tSchedule of the matvec and SSOR loops on an\n"
+	    "\t\t\tELLPACK-R matrix: static or steal (chunks with\n"
+	    "\t\t\tequal nonzeros, idle threads steal them from\n"
+	    "\t\t\ttheir neighbors). steal prints the busy and\n"
+	    "\t\t\tidle time of every thread.\n"
+	    "\tCG_REPRODUCIBLE\tDot products and norms bitwise independent of\n"
+	    "\t\t\tthe number of threads (1), also with\n"
+	    "\t\t\tcompensated summation (2), or not (0).\n"
 	    "The defaults are:\n"
 	    "\tCG_MAX_ITER\t1000\n"
 	    "\tCG_TOLERANCE\t0.0000001\n"
+	    "\tCG_OUTPUT\ttext\n"
+	    "\tCG_OUTPUT_FILE\tx.out\n"
+	    "\tCG_HUGEPAGES\tnone\n"
+	    "\tCG_CHECKPOINT_INTERVAL\t500\n"
+	    "\tCG_PARTITION\t0\n"
+	    "\tCG_KERNEL\tauto\n"
+	    "\tCG_SPECIALIZE\t1\n"
+	    "\tCG_FORMAT\tell\n"
+	    "\tCG_PREFETCH\t0\n"
+	    "\tCG_PRECOND\tnone\n"
+	    "\tCG_OMEGA\t1.0\n"
+	    "\tCG_DEGREE\t4\n"
+	    "\tCG_SMOOTHER\tjacobi\n"
+	    "\tCG_DEFLATE\t0\n"
+	    "\tCG_TASKS\t0\n"
+	    "\tCG_SCHEDULE\tstatic\n"
+	    "\tCG_REPRODUCIBLE\t0\n"
 	    "\n", argv0);
 }
@@ -15,6 +15,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdint.h>
 #include <errno.h>
 
 #ifndef _WIN32
@@ -27,23 +28,57 @@
 
 #include "io.h"
 #include "mmio.h"
+#include "alloc.h"
+#include "solver.h"
+
+/* Append the entry (row, col, val) to the coordinate arrays,
+ * which are enlarged if all capacity entries are in use. */
+static void appendEntry(const int row, const int col, const floatType val, offsetType* nnz, offsetType* capacity, int** I, int** J, floatType** V){
+	if (*nnz == *capacity) {
+		*capacity = 2 * (*capacity) + 1024;
+		*I = (int*)realloc(*I, sizeof(int) * (size_t)(*capacity));
+		*J = (int*)realloc(*J, sizeof(int) * (size_t)(*capacity));
+		*V = (floatType*)realloc(*V, sizeof(floatType) * (size_t)(*capacity));
+
+		/* Check if the memory was allocated successfully */
+		if (*I == NULL || *J == NULL || *V == NULL) {
+			puts("Out of memory!");
+			fatalError();
+		}
+	}
 
-/* Parse the matrix market file "filename" and return
- * the matrix in ELLPACK-R format in A. */
-void parseMM(char *filename, int* n, int* nnz, int* maxNNZ, floatType** data, int** indices, int** length){
-	int M,N;
-	int i,j;
-	int *I, *J, *offset;
-	floatType *V;
+	(*I)[*nnz] = row;
+	(*J)[*nnz] = col;
+	(*V)[*nnz] = val;
+	(*nnz)++;
+}
+
+/* Read the matrix market file "filename" and return the matrix
+ * in coordinate format: entry k has the value V[k] in row I[k] and
+ * column J[k], both 0-based. Symmetric files are expanded so that
+ * the upper and lower triangular are stored. */
+void readMM(char *filename, int* n, offsetType* nnz, int** I, int** J, floatType** V){
+	readMMRows(filename, 0, 1, n, nnz, I, J, V);
+}
+
+/* Like readMM(), but only return the entries of the rows
+ * [part * n / parts, (part + 1) * n / parts), so each of parts
+ * processes only needs memory for its own block of rows. */
+void readMMRows(char *filename, const int part, const int parts, int* n, offsetType* nnz, int** I, int** J, floatType** V){
+	int M,N,NZ;
+	int row, col, first, last;
+	offsetType i, capacity;
+	floatType val;
 	FILE *fp;
 	MM_typecode matcode;
 
+	if (config.verbose)
 	printf("Start matrix parse.\n");
 
 	/* Try to open the file and return a error if not possible */
 	if ((fp = fopen(filename, "r")) == NULL) {
 		printf("ERROR: Cant open file!\n");
-		exit(1);
+		fatalError();
 	}
 
 	/* Read the banner of the matrix market matrix. You should
@@ -51,7 +86,8 @@ void parseMM(char *filename, int* n, int* nnz, int* maxNNZ, floatType** data, in
 	 * point. Exit in case of unsupported files. */
 	if (mm_read_banner(fp, &matcode) != 0) {
 		printf("ERROR: Could not process Matrix Market banner.\n");
-		exit(1);
+		fclose(fp);
+		fatalError();
 	}
 
 	/* This is how one can screen matrix types if their application 
@@ -62,155 +98,441 @@ void parseMM(char *filename, int* n, int* nnz, int* maxNNZ, floatType** data, in
 		printf("ERROR: Sorry, this application does not support ");
 		printf("Market Market type: [%s]\n",
 		    mm_typecode_to_str(matcode));
-		exit(1);
+		fclose(fp);
+		fatalError();
 	}
 
 	/* Find out size of sparse matrix from the file */
-	if (mm_read_mtx_crd_size(fp, &M, &N, nnz) != 0) {
+	if (mm_read_mtx_crd_size(fp, &M, &N, &NZ) != 0) {
 		printf("ERROR: Could not read matrix size!\n");
-		exit(1);
+		fclose(fp);
+		fatalError();
 	}
 
 	/* Exit for non square matrices. */
 	if (N != M) {
 		printf("ERROR: Naahhh. Come on, give me a NxN matrix!\n");
-		exit(1);
+		fclose(fp);
+		fatalError();
 	}
 
+	if (config.verbose)
 	printf("Start memory allocation.\n");
 
+	capacity = NZ;
+
 	/* if the matrix is stored in the symmetric format we will
 	 * increase the number of nnz to store the upper and lower triangular */
 	if (mm_is_symmetric(matcode)){
 
 		/* store upper and lower triangular */
-		(*nnz) = 2 * (*nnz) - N;
-	}
-
-
-
-	/* Allocate some of the memory for the ELLPACK-R matrix */
-	*length = (int*) malloc(sizeof(int) * N);
-
-	/* Check if the memory was allocated successfully */
-	if (*length == NULL) {
-		puts("Out of memory!");
-		exit(1);
-	}
-
-	/* Initialize the length pointer of the matrix */
-	for (i = 0; i < N + 1; i++) {
-		(*length)[i] = 0;
+		if (2LL * NZ - N > OFFSET_MAX) {
+			printf("ERROR: Too many non zeros, rebuild with \"make large=1\"!\n");
+			fclose(fp);
+			fatalError();
+		}
+		capacity = 2 * capacity - N;
 	}
 
-	/* Set the number of non zeros (nnz) and the dimension (n)
-	 * of the matrix */
+	/* Set the dimension (n) of the matrix and the rows to keep */
 	*n = N;
-
-	/* Alocate the temporary  memory for matrix market matrix which
-	 * has to be converted to the ELLPACK-R format */
-	I = (int*)malloc(sizeof(int) * (*nnz));
-	J = (int*)malloc(sizeof(int) * (*nnz));
-	V = (floatType*)malloc(sizeof(floatType) * (*nnz));
+	first = (int)((long long)N * part / parts);
+	last = (int)((long long)N * (part + 1) / parts);
+
+	/* Alocate the memory for matrix market matrix. The number of
+	 * entries is only known for the whole matrix, for a part of
+	 * it the arrays grow as needed. */
+	if (parts > 1)
+		capacity = capacity / parts;
+	*nnz = 0;
+	*I = (int*)malloc(sizeof(int) * (size_t)capacity);
+	*J = (int*)malloc(sizeof(int) * (size_t)capacity);
+	*V = (floatType*)malloc(sizeof(floatType) * (size_t)capacity);
 
 	/* Check if the memory was allocated successfully */
-	if (I == NULL || J == NULL || V == NULL) {
+	if (*I == NULL || *J == NULL || *V == NULL) {
 		puts("Out of memory!");
-		exit(1);
+		fclose(fp);
+		fatalError();
 	}
 
-	/* Allocate and initialize some more temporay memory */
-	if ((offset = (int*)malloc(sizeof(int) * (*nnz))) == NULL) {
-		puts("Out of memory!");
-		exit(1);
-	}
-	memset(offset, 0, (*nnz) * sizeof(int));
-
+	if (config.verbose)
 	printf("Read from file.\n");
 
 	/* Start reading the file and store the values */
-	for (i = 0; i < (*nnz); i++) {
-		fscanf(fp, "%d %d %lg\n", &I[i], &J[i], &V[i]);
-
-		/* count double if entry is not on diag and in symmetric file format */
-		if (I[i] != J[i] && mm_is_symmetric(matcode)){
-			((*length)[I[i]-1])++;
-			i++;
-			I[i] = J[i-1];
-			J[i] = I[i-1];
-
-			I[i-1]--;  /* adjust from 1-based to 0-based */
-			J[i-1]--;
-
-			V[i] = V[i-1];
+	for (i = 0; i < NZ; i++) {
+		if (fscanf(fp, "%d %d %lg\n", &row, &col, &val) != 3 ||
+		    row < 1 || row > N || col < 1 || col > N) {
+			printf("ERROR: Invalid entry %lld of the matrix!\n", (long long)i + 1);
+			fclose(fp);
+			fatalError();
 		}
 
-
 		 /* Adjust from 1-based to 0-based which means that in
 		  * the matrix market file format the first index is
 		  * always 1, but in C the first index is always 0. */
-		I[i]--; 
-		J[i]--;
+		row--;
+		col--;
+
+		if (row >= first && row < last)
+			appendEntry(row, col, val, nnz, &capacity, I, J, V);
 
-		/* Count entries in one row */
-		((*length)[I[i]])++;
+		/* count double if entry is not on diag and in symmetric file format */
+		if (row != col && mm_is_symmetric(matcode) && col >= first && col < last)
+			appendEntry(col, row, val, nnz, &capacity, I, J, V);
 	}
 
+	fclose(fp);
+}
 
-	printf("Start converting from MM to ELLPACK-R.\n");
+/* Convert the n x n matrix given in coordinate format (0-based
+ * I, J, V with nnz entries) to the ELLPACK-R format in parallel.
+ * Every thread owns the rows n*r/threads ... n*(r+1)/threads-1 of
+ * its row range r, like in the static schedule of the kernels. The
+ * entries are first sorted by row range: every chunk of the entries
+ * counts its entries per range, the prefix sums give every chunk
+ * its first position in each range, and the chunks store the
+ * numbers of their entries in order there. Then every thread counts
+ * and scatters the entries of its own rows. The entries of a row
+ * keep the order of I, J, V, as in a serial conversion. */
+void cooToEll(const int n, const offsetType nnz, const int* I, const int* J, const floatType* V, int* maxNNZ, floatType** data, int** indices, int** length){
+	int i, j, t, r, width;
+	offsetType k, p, pos, count;
+	offsetType *bucket, *rangeStart, *order;
 
-	/* Get maximum Number of NNZs per row for the ELLPACK-R format */
-	*maxNNZ = 0;
-	for (i = 0; i < N; i++) {
-		if ((*length)[i] > (*maxNNZ)) {
-			(*maxNNZ) = (*length)[i];
-		}
-	}
+	/* Allocate some of the memory for the ELLPACK-R matrix */
+	*length = (int*) allocLarge(sizeof(int) * n);
 
-	/* Allocate the rest of the memory for the ELLPACK-R matrix */
-	*data = (floatType*) malloc(sizeof(floatType) * N * (*maxNNZ));
-	*indices = (int*) malloc(sizeof(int) * N * (*maxNNZ));
+	/* bucket[t * threads + r] counts the entries of chunk t in row
+	 * range r, order holds the numbers of the entries sorted by row
+	 * range, and the entries of range r start at rangeStart[r] */
+	bucket = (offsetType*) malloc(sizeof(offsetType) * ((size_t)threads * threads + threads + 1));
+	order = (offsetType*) malloc(sizeof(offsetType) * (size_t)nnz);
 
 	/* Check if the memory was allocated successfully */
-	if (*data == NULL || *indices == NULL) {
+	if (bucket == NULL || order == NULL) {
 		puts("Out of memory!");
-		exit(1);
+		fatalError();
+	}
+	rangeStart = bucket + (size_t)threads * threads;
+
+	/* Count the entries of every chunk per row range. Row i is in
+	 * the range r with n*r/threads <= i < n*(r+1)/threads. */
+#pragma omp parallel for num_threads(threads) private(t, k)
+	for (t = 0; t < threads; t++) {
+		offsetType* counts = bucket + (size_t)t * threads;
+		memset(counts, 0, sizeof(offsetType) * threads);
+		for (k = (offsetType)((long long)t * nnz / threads); k < (offsetType)((long long)(t + 1) * nnz / threads); k++)
+			counts[(((long long)I[k] + 1) * threads - 1) / n]++;
+	}
+
+	/* Replace the counts by the first position of the chunk in the
+	 * row range */
+	pos = 0;
+	for (r = 0; r < threads; r++) {
+		rangeStart[r] = pos;
+		for (t = 0; t < threads; t++) {
+			count = bucket[(size_t)t * threads + r];
+			bucket[(size_t)t * threads + r] = pos;
+			pos += count;
+		}
+	}
+	rangeStart[threads] = pos;
+
+	/* Sort the entries by row range */
+#pragma omp parallel for num_threads(threads) private(t, k)
+	for (t = 0; t < threads; t++) {
+		offsetType* next = bucket + (size_t)t * threads;
+		for (k = (offsetType)((long long)t * nnz / threads); k < (offsetType)((long long)(t + 1) * nnz / threads); k++)
+			order[next[(((long long)I[k] + 1) * threads - 1) / n]++] = k;
+	}
+
+	if (config.verbose)
+	printf("Start converting from MM to ELLPACK-R.\n");
+
+	/* Count the entries of every row. Get the maximum number of
+	 * NNZs per row for the ELLPACK-R format on the way. */
+	width = 0;
+#pragma omp parallel for num_threads(threads) private(r, i, p) reduction(max:width)
+	for (r = 0; r < threads; r++) {
+		for (i = (int)((long long)n * r / threads); i < (int)((long long)n * (r + 1) / threads); i++)
+			(*length)[i] = 0;
+		for (p = rangeStart[r]; p < rangeStart[r + 1]; p++)
+			(*length)[I[order[p]]]++;
+		for (i = (int)((long long)n * r / threads); i < (int)((long long)n * (r + 1) / threads); i++)
+			if ((*length)[i] > width)
+				width = (*length)[i];
+	}
+	*maxNNZ = width;
+
+	/* The positions j * n + i in the ELLPACK-R arrays must fit
+	 * into offsetType */
+	if ((*maxNNZ) > 0 && n > OFFSET_MAX / (*maxNNZ)) {
+		printf("ERROR: Matrix has more than 2^31 stored elements, rebuild with \"make large=1\"!\n");
+		free(bucket);
+		free(order);
+		fatalError();
 	}
 
-	/* Convert from MM to ELLPACK-R */
-	for (j = 0; j < (*nnz); j++){
-		i = I[j];
+	/* Allocate the rest of the memory for the ELLPACK-R matrix.
+	 * allocLarge() exits if no memory is available. */
+	*data = (floatType*) allocLarge(sizeof(floatType) * (size_t)n * (*maxNNZ));
+	*indices = (int*) allocLarge(sizeof(int) * (size_t)n * (*maxNNZ));
 
-		/* Store data and indices in column-major order */
-		(*data)[offset[i] * N + i] = V[j];
-		(*indices)[offset[i] * N + i] = J[j];
-		
-		offset[i]++;
+	/* Insert 0's for padding in data and indices array. All
+	 * positions are written here, with the same static partition
+	 * of the rows as in the kernels, so every page is placed on
+	 * the NUMA node of the thread which multiplies its rows. */
+#pragma omp parallel for num_threads(threads) private(i, j)
+	for (i = 0; i < n; i++) {
+		for (j = 0; j < (*maxNNZ); j++) {
+			(*data)[(offsetType)j * n + i] = 0.0;
+			(*indices)[(offsetType)j * n + i] = 0;
+		}
 	}
 
-	/* Insert 0's for padding in data and indices array */
-	for (i = 0; i < N; i++) {
-		for (j = (*length)[i]; j < (*maxNNZ); j++) {
-			(*data)[j * N + i] = 0.0;
-			(*indices)[j * N + i] = 0;
+	/* Convert from MM to ELLPACK-R. length counts the entries
+	 * stored so far and ends with the same values again. */
+#pragma omp parallel for num_threads(threads) private(r, i, p, k)
+	for (r = 0; r < threads; r++) {
+		for (i = (int)((long long)n * r / threads); i < (int)((long long)n * (r + 1) / threads); i++)
+			(*length)[i] = 0;
+		for (p = rangeStart[r]; p < rangeStart[r + 1]; p++) {
+			k = order[p];
+			i = I[k];
+
+			/* Store data and indices in column-major order */
+			(*data)[(offsetType)(*length)[i] * n + i] = V[k];
+			(*indices)[(offsetType)(*length)[i] * n + i] = J[k];
+
+			(*length)[i]++;
 		}
 	}
 
+	/* Clean up */
+	free(bucket);
+	free(order);
+}
+
+/* Parse the matrix market file "filename" and return
+ * the matrix in ELLPACK-R format in A. */
+void parseMM(char *filename, int* n, offsetType* nnz, int* maxNNZ, floatType** data, int** indices, int** length){
+	int *I, *J;
+	floatType *V;
+
+	readMM(filename, n, nnz, &I, &J, &V);
+	cooToEll(*n, *nnz, I, J, V, maxNNZ, data, indices, length);
+
+	if (config.verbose)
 	printf("MM Parse done.\n");
 
 	/* Clean up */
-	free(offset);
 	free(I);
 	free(J);
 	free(V);
-	fclose(fp);
 }
 
 /* Free the complete memory of the matrix in ELLPACK-R format */
 void destroyMatrix(floatType* data, int* indices, int* length) {
-	free(data);
-	free(indices);
-	free(length);
+	freeLarge(data);
+	freeLarge(indices);
+	freeLarge(length);
+}
+
+/* Write the n entries of x to the file "filename" in the given format.
+ * The text format prints one value per line with enough digits to
+ * read back the exact binary value. The values are formatted in
+ * parallel into large buffers, each written with a single fwrite.
+ * The binary format writes a struct VectorHeader followed by the
+ * raw values. Nothing is written for OUTPUT_NONE. */
+void writeVector(const char *filename, const floatType *x, const int n, const enum OutputFormat format){
+	struct VectorHeader header;
+	FILE *fp;
+	char *buf;
+	size_t len[WRITE_CHUNKS];
+	int start, count, chunk, c, i;
+
+	if (format == OUTPUT_NONE)
+		return;
+
+	if ((fp = fopen(filename, format == OUTPUT_BINARY ? "wb" : "w")) == NULL) {
+		printf("ERROR: Failed to write output file %s!\n", filename);
+		fatalError();
+	}
+
+	if (format == OUTPUT_BINARY) {
+		memcpy(header.magic, VECTOR_MAGIC, sizeof(header.magic));
+		header.n = n;
+		header.elementSize = sizeof(floatType);
+		header.byteOrder = VECTOR_BYTE_ORDER;
+
+		if (fwrite(&header, sizeof(header), 1, fp) != 1 ||
+		    fwrite(x, sizeof(floatType), n, fp) != (size_t)n) {
+			printf("ERROR: Failed to write output file %s!\n", filename);
+			fatalError();
+		}
+		fclose(fp);
+		return;
+	}
+
+	/* Format blocks of WRITE_BLOCK values. Every block is split into
+	 * WRITE_CHUNKS chunks which own a fixed slice of the buffer. */
+	chunk = (WRITE_BLOCK + WRITE_CHUNKS - 1) / WRITE_CHUNKS;
+	if ((buf = (char*)malloc((size_t)WRITE_CHUNKS * chunk * TEXT_WIDTH)) == NULL) {
+		puts("Out of memory!");
+		fatalError();
+	}
+
+	for (start = 0; start < n; start += WRITE_BLOCK) {
+		count = (n - start < WRITE_BLOCK) ? n - start : WRITE_BLOCK;
+
+#pragma omp parallel for private(c, i) schedule(static, 1)
+		for (c = 0; c < WRITE_CHUNKS; c++) {
+			char *out = buf + (size_t)c * chunk * TEXT_WIDTH;
+			int first = c * chunk;
+			int last = (first + chunk < count) ? first + chunk : count;
+
+			len[c] = 0;
+			for (i = start + first; i < start + last; i++)
+				len[c] += snprintf(out + len[c], TEXT_WIDTH, "%.16e\n", x[i]);
+		}
+
+		for (c = 0; c < WRITE_CHUNKS; c++) {
+			if (fwrite(buf + (size_t)c * chunk * TEXT_WIDTH, 1, len[c], fp) != len[c]) {
+				printf("ERROR: Failed to write output file %s!\n", filename);
+				fatalError();
+			}
+		}
+	}
+
+	free(buf);
+	fclose(fp);
+}
+
+/* Read the n entries of x from the file "filename", written by
+ * writeVector() either in the binary or in the text format. */
+void readVector(const char *filename, floatType *x, const int n){
+	struct VectorHeader header;
+	floatType extra;
+	FILE *fp;
+	int i;
+
+	if ((fp = fopen(filename, "rb")) == NULL) {
+		printf("ERROR: Cant open file %s!\n", filename);
+		fatalError();
+	}
+
+	if (fread(&header, sizeof(header), 1, fp) == 1 &&
+	    !memcmp(header.magic, VECTOR_MAGIC, sizeof(header.magic))) {
+		if (header.n != n || header.elementSize != sizeof(floatType) ||
+		    header.byteOrder != VECTOR_BYTE_ORDER) {
+			printf("ERROR: Vector in %s does not match the matrix!\n", filename);
+			fatalError();
+		}
+
+		if (fread(x, sizeof(floatType), n, fp) != (size_t)n) {
+			printf("ERROR: Could not read vector from %s!\n", filename);
+			fatalError();
+		}
+	} else {
+		/* No binary header, read one value per line */
+		rewind(fp);
+		for (i = 0; i < n; i++) {
+			if (fscanf(fp, "%lg", &x[i]) != 1) {
+				printf("ERROR: Could not read vector from %s!\n", filename);
+				fatalError();
+			}
+		}
+
+		if (fscanf(fp, "%lg", &extra) != EOF) {
+			printf("ERROR: Vector in %s does not match the matrix!\n", filename);
+			fatalError();
+		}
+	}
+
+	fclose(fp);
+}
+
+/* Save the state of the CG algorithm after iter iterations to the
+ * file "filename". The state is written to a temporary file first
+ * and then renamed, so an interrupted write never destroys the
+ * previous checkpoint. Returns 0 after printing the error if the
+ * checkpoint could not be written, so it may be called in parallel
+ * regions, where fatalError() must not be called. */
+int tryWriteCheckpoint(const char *filename, const int n, const floatType *x, const floatType *r, const floatType *p, const floatType rho, const floatType bnrm2, const int iter){
+	struct CheckpointHeader header;
+	char tmp[4096];
+	FILE *fp;
+
+	snprintf(tmp, sizeof(tmp), "%s.tmp", filename);
+	if ((fp = fopen(tmp, "wb")) == NULL) {
+		printf("ERROR: Failed to write checkpoint %s!\n", tmp);
+		return 0;
+	}
+
+	memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+	header.n = n;
+	header.elementSize = sizeof(floatType);
+	header.iter = iter;
+	header.rho = rho;
+	header.bnrm2 = bnrm2;
+
+	if (fwrite(&header, sizeof(header), 1, fp) != 1 ||
+	    fwrite(x, sizeof(floatType), n, fp) != (size_t)n ||
+	    fwrite(r, sizeof(floatType), n, fp) != (size_t)n ||
+	    fwrite(p, sizeof(floatType), n, fp) != (size_t)n ||
+	    fclose(fp) != 0) {
+		printf("ERROR: Failed to write checkpoint %s!\n", tmp);
+		return 0;
+	}
+
+	if (rename(tmp, filename) != 0) {
+		printf("ERROR: Failed to write checkpoint %s!\n", filename);
+		return 0;
+	}
+	return 1;
+}
+
+/* As tryWriteCheckpoint(), but a failure is fatal */
+void writeCheckpoint(const char *filename, const int n, const floatType *x, const floatType *r, const floatType *p, const floatType rho, const floatType bnrm2, const int iter){
+	if (!tryWriteCheckpoint(filename, n, x, r, p, rho, bnrm2, iter))
+		fatalError();
+}
+
+/* Load the state of the CG algorithm from the checkpoint file
+ * "filename" written by writeCheckpoint() */
+void readCheckpoint(const char *filename, const int n, floatType *x, floatType *r, floatType *p, floatType *rho, floatType *bnrm2, int *iter){
+	struct CheckpointHeader header;
+	FILE *fp;
+
+	if ((fp = fopen(filename, "rb")) == NULL) {
+		printf("ERROR: Cant open checkpoint %s!\n", filename);
+		fatalError();
+	}
+
+	if (fread(&header, sizeof(header), 1, fp) != 1 ||
+	    memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic))) {
+		printf("ERROR: %s is no checkpoint file!\n", filename);
+		fatalError();
+	}
+
+	if (header.n != n || header.elementSize != sizeof(floatType)) {
+		printf("ERROR: Checkpoint %s does not match the matrix!\n", filename);
+		fatalError();
+	}
+
+	if (fread(x, sizeof(floatType), n, fp) != (size_t)n ||
+	    fread(r, sizeof(floatType), n, fp) != (size_t)n ||
+	    fread(p, sizeof(floatType), n, fp) != (size_t)n) {
+		printf("ERROR: Could not read checkpoint %s!\n", filename);
+		fatalError();
+	}
+
+	*rho = header.rho;
+	*bnrm2 = header.bnrm2;
+	*iter = header.iter;
+
+	fclose(fp);
 }
 
 /* Print out to std the first n elements of the vector x */
@@ -225,8 +547,9 @@ void printVector(const floatType *x, const int n) {
 
 
 /* Print out the whole ELLPACK-R matrix to std */
-void printMatrix(const int n, const int nnz, const int maxNNZ, const floatType* data, const int* indices, const int* length) {
-	int i, j, k;
+void printMatrix(const int n, const offsetType nnz, const int maxNNZ, const floatType* data, const int* indices, const int* length) {
+	int i, j;
+	offsetType k;
 
 	for (i = 0; i < n; i++) {
 		if (i == 0) {
@@ -236,7 +559,7 @@ void printMatrix(const int n, const int nnz, const int maxNNZ, const floatType*
 			printf("]\nRow %d: [", i);
 		}
 		for (j = 0; j < length[i]; j++) {
-			k = j * n + i;
+			k = (offsetType)j * n + i;
 			printf("%d:", indices[k]);
 			printf("%f' ", data[k]);
 		}
@@ -14,14 +14,55 @@
 #ifndef __IO_H__
 #define __IO_H__
 
+#include <stdint.h>
+
 #include "def.h"
 
+/* Values per block and parallel chunks per block when writing
+ * text output. Every formatted value takes at most TEXT_WIDTH
+ * characters ("-1.2345678901234567e+308\n" plus the '\0'). */
+#define WRITE_BLOCK (1 << 20)
+#define WRITE_CHUNKS 256
+#define TEXT_WIDTH 32
+
+/* Header of binary vector files. The byte order field holds
+ * VECTOR_BYTE_ORDER written in the byte order of the writer. */
+#define VECTOR_MAGIC "CGVECTOR"
+#define VECTOR_BYTE_ORDER 0x01020304
+struct VectorHeader {
+	char magic[8];
+	int64_t n;
+	int32_t elementSize;
+	int32_t byteOrder;
+};
+
+/* Header of checkpoint files, followed by the vectors x, r and p.
+ * It holds the iterations done so far and the scalars needed to
+ * continue the CG algorithm exactly. */
+#define CHECKPOINT_MAGIC "CGCHECKP"
+struct CheckpointHeader {
+	char magic[8];
+	int64_t n;
+	int32_t elementSize;
+	int32_t iter;
+	double rho;
+	double bnrm2;
+};
+
 #ifdef __cplusplus
 extern "C" {
 #endif
-void parseMM(char *filename, int* n, int* nnz, int* maxNNZ, floatType** data, int** indices, int** length);
+void readMM(char *filename, int* n, offsetType* nnz, int** I, int** J, floatType** V);
+void readMMRows(char *filename, const int part, const int parts, int* n, offsetType* nnz, int** I, int** J, floatType** V);
+void cooToEll(const int n, const offsetType nnz, const int* I, const int* J, const floatType* V, int* maxNNZ, floatType** data, int** indices, int** length);
+void parseMM(char *filename, int* n, offsetType* nnz, int* maxNNZ, floatType** data, int** indices, int** length);
+void writeVector(const char *filename, const floatType *x, const int n, const enum OutputFormat format);
+void readVector(const char *filename, floatType *x, const int n);
+int tryWriteCheckpoint(const char *filename, const int n, const floatType *x, const floatType *r, const floatType *p, const floatType rho, const floatType bnrm2, const int iter);
+void writeCheckpoint(const char *filename, const int n, const floatType *x, const floatType *r, const floatType *p, const floatType rho, const floatType bnrm2, const int iter);
+void readCheckpoint(const char *filename, const int n, floatType *x, floatType *r, floatType *p, floatType *rho, floatType *bnrm2, int *iter);
 void printVector(const floatType *x, int n);
-void printMatrix(const int n, const int nnz, const int maxNNZ, const floatType* data, const int* indices, const int* length);
+void printMatrix(const int n, const offsetType nnz, const int maxNNZ, const floatType* data, const int* indices, const int* length);
 void destroyMatrix(floatType* data, int* indices, int* length);
 #ifdef __cplusplus
 }
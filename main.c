@@ -31,29 +31,57 @@
 #include "errorcheck.h"
 #include "output.h"
 #include "io.h"
+#include "alloc.h"
+#include "dist.h"
+#include "partition.h"
+#include "stencil.h"
+#include "precond.h"
+#include "dataflow.h"
+#include "steal.h"
 
 
 /* Init the right hand side (rhs), so that the solution is one for 
  * every entry in the x vector. Please note that due to rounding
  * errors this solution will not be reached for the implemented cg
  * method. For the error checking it is enought to check the residual. */
-void initLGS(const int n, const int nnz, const int maxNNZ, const floatType* data, const int* indices, const int* length, floatType* b, floatType* x){
+void initLGS(const int n, const offsetType nnz, const int maxNNZ, const floatType* data, const int* indices, const int* length, floatType* b, floatType* x){
 	int i,j;
 	memset(b, 0, n * sizeof(floatType));
 	for(i = 0; i < n; i++){
 		x[i] = 0;
 		for (j = 0; j < length[i]; j++) {
-			b[i] += data[j * n + i];
+			b[i] += data[(offsetType)j * n + i];
 		}
 	}
 }
 
+/* The same for a matrix which is only given as an operator */
+void initOperatorLGS(const struct Operator* A, floatType* b, floatType* x){
+	int i;
+	for (i = 0; i < A->n; i++)
+		x[i] = 1.0;
+	A->apply(A, x, b);
+	for (i = 0; i < A->n; i++)
+		x[i] = 0.0;
+}
+
 int main(int argc, char *argv[]){
 	struct SolverConfig sc;
-	floatType *b, *x;
+	struct Operator* A;
+	struct Preconditioner* M;
+	struct TaskMatrix* T = NULL;
+	struct Workspace* ws;
+	floatType *b, *x, *xOut;
 	floatType residual, bnrm2;
-	int correct;
-	double ioTime, solveTime, totalTime;
+	int correct, domains;
+	int* perm = NULL;
+	double remoteBefore, remoteAfter;
+	char remote[64];
+	double ioTime, solveTime, outputTime, totalTime;
+	size_t totalBytes, hugeBytes;
+	char hugePages[64];
+	char format[64];
+	char precond[64];
 
 	/* The folloing variables are used to 
 	 * represent the matrix which is saved in a 
@@ -123,7 +151,7 @@ int main(int argc, char *argv[]){
 	 *
 	 * A.length  | 1| 2| 2| 3| */
 	int n;            
-	int nnz;           
+	offsetType nnz;
 	int maxNNZ;
 	floatType* data = NULL;
 	int* indices = NULL;
@@ -144,71 +172,176 @@ int main(int argc, char *argv[]){
 	/* Check environment variables CG_TOLERANCE and CG_MAX_ITER */
 	init();
 
+#ifdef USE_MPI
+	/* Distribute the matrix over all MPI ranks */
+	return distMain(argc, argv);
+#endif
+
 	/* Start time measurement for the total time */
 	totalTime = getWTime();
 
-	/* Parse the matrix, stop the time for IO. Please note that
-	 * you do not have to optimize the IO time, because only the 
-	 * solving time will be valued.  */
-	ioTime = getWTime();
-	parseMM(argv[1], &n, &nnz, &maxNNZ, &data, &indices, &length);
-	ioTime = getWTime() - ioTime;
+	/* The NUMA domains, which the matrix is partitioned for */
+	domains = numaDomains();
+	if (!strncmp(argv[1], STENCIL_PREFIX, strlen(STENCIL_PREFIX))) {
+		/* A problem on a structured grid. Only its operator is
+		 * created, the matrix is never stored. */
+		ioTime = getWTime();
+		A = createStencilOperator(argv[1] + strlen(STENCIL_PREFIX));
+		n = A->n;
+		nnz = A->nnz;
+		maxNNZ = 0;
+		ioTime = getWTime() - ioTime;
+		snprintf(remote, sizeof(remote), "-");
+	} else {
+		/* Parse the matrix, stop the time for IO. Please note that
+		 * you do not have to optimize the IO time, because only the 
+		 * solving time will be valued.  */
+		ioTime = getWTime();
+		parseMM(argv[1], &n, &nnz, &maxNNZ, &data, &indices, &length);
+		ioTime = getWTime() - ioTime;
+
+		/* Renumber the matrix so that every NUMA domain gets a
+		 * connected block of rows and few x entries of the other
+		 * domains are used. The order of the file is kept if it
+		 * is already better. */
+		remoteBefore = remoteAfter = remoteAccesses(n, indices, length, domains, NULL);
+		if (config.partition) {
+			perm = (int*)malloc(sizeof(int) * n);
+			if (perm == NULL) {
+				puts("Out of memory!");
+				fatalError();
+			}
+			partitionGraph(n, indices, length, perm);
+			remoteAfter = remoteAccesses(n, indices, length, domains, perm);
+			if (remoteAfter < remoteBefore) {
+				permuteMatrix(n, maxNNZ, &data, &indices, &length, perm);
+			} else {
+				remoteAfter = remoteBefore;
+				free(perm);
+				perm = NULL;
+			}
+		}
+		snprintf(remote, sizeof(remote), "%.2f%% -> %.2f%%", 100.0 * remoteBefore, 100.0 * remoteAfter);
+
+		/* Store the matrix in the format of CG_FORMAT */
+		A = createOperator(n, nnz, maxNNZ, data, indices, length);
+	}
+
+	/* Set up the preconditioner of CG_PRECOND once for the matrix */
+	M = createPreconditioner(A, maxNNZ, data, indices, length);
+
+	/* Split the matrix into the row blocks of CG_TASKS */
+	if (config.tasks > 0) {
+#ifdef HAVE_TASK_CG
+		if (data != NULL && M == NULL)
+			T = createTaskMatrix(n, nnz, maxNNZ, data, indices, length, config.tasks);
+		else
+			printf("WARNING: CG_TASKS needs a stored matrix and no preconditioner, using the parallel loops.\n");
+#else
+		printf("WARNING: CG_TASKS needs OpenMP 5.0 task dependencies, using the parallel loops.\n");
+#endif
+	}
+
+	/* Only the ELLPACK-R matvec and SSOR have a work-stealing schedule */
+	if (config.schedule == SCHEDULE_STEAL) {
+		if (T != NULL)
+			printf("WARNING: CG_SCHEDULE=steal does not apply to CG_TASKS, the tasks are scheduled by the OpenMP runtime.\n");
+		else if (strncmp(A->format, "ELLPACK-R", 9) != 0)
+			printf("WARNING: CG_SCHEDULE=steal only applies to ELLPACK-R, the matvec of \"%s\" uses the static schedule.\n", A->format);
+	}
 
 	/* Allocate memory for the LGS */
-	b = (floatType*)malloc(n * sizeof(floatType));
-	x = (floatType*)malloc(n * sizeof(floatType));
+	b = (floatType*)allocLarge(n * sizeof(floatType));
+	x = (floatType*)allocLarge(n * sizeof(floatType));
 
 	/* Init the LGS */
-	initLGS(n, nnz, maxNNZ, data, indices, length, b, x);
+	if (data != NULL)
+		initLGS(n, nnz, maxNNZ, data, indices, length, b, x);
+	else
+		initOperatorLGS(A, b, x);
 
 	/* Calculate the initial residuum for error checking */
-	bnrm2 = get_residual(n, nnz, maxNNZ, data, indices, length, b, x);
+	bnrm2 = (data != NULL) ? get_residual(n, nnz, maxNNZ, data, indices, length, b, x) : get_operator_residual(A, b, x);
+
+	/* Start from a given solution instead of x = 0 */
+	if (config.initialGuess != NULL) {
+		readVector(config.initialGuess, x, n);
+		if (perm != NULL) {
+			xOut = (floatType*)allocLarge(n * sizeof(floatType));
+			memcpy(xOut, x, n * sizeof(floatType));
+			permuteVector(n, perm, xOut, x);
+			freeLarge(xOut);
+		}
+	}
 	
 	/* Set the solver configuration */
 	sc.maxIter = config.maxIter;
 	sc.tolerance = config.tolerance;
+	sc.verbose = 1;
+	sc.checkpointFile = config.checkpointFile;
+	sc.checkpointInterval = config.checkpointInterval;
+	sc.restartFile = config.restartFile;
+	sc.alphas = sc.betas = NULL;
+
+	/* Allocate the scratch vectors of the solver */
+	ws = createWorkspace(n);
 
 
 	/* Solving the system of linear equations including the time measurement.
 	 * You should try to optimize this time, this will be valued for the
 	 * competition. */
 	solveTime = getWTime();
-	cg(n, nnz, maxNNZ, data, indices, length, b, x, &sc);
+	if (T != NULL)
+		taskCg(T, b, x, &sc, ws);
+	else
+		cg(A, M, b, x, &sc, ws);
 	solveTime = getWTime()-solveTime;
 
+	/* Undo the renumbering for the output */
+	xOut = x;
+	if (perm != NULL) {
+		xOut = (floatType*)allocLarge(n * sizeof(floatType));
+		unpermuteVector(n, perm, x, xOut);
+	}
+
 	/* Print solution vector x or the first 10 values of the result. 
 	 * Should be 1 in case of convergence. */
 	if (n > 10){
 		printf("First 10 values of the solution vector x = ");
-		printVector(x, 10);
+		printVector(xOut, 10);
 	} else {
 		printf("Solution vector x = ");
-		printVector(x, n);
+		printVector(xOut, n);
 	}
 	
 	/* Check error */
-	residual = get_residual(n, nnz, maxNNZ, data, indices, length, b, x);
+	residual = (data != NULL) ? get_residual(n, nnz, maxNNZ, data, indices, length, b, x) : get_operator_residual(A, b, x);
 	correct = check_error(bnrm2, residual, sc.tolerance);
 
-	FILE *fp;
-	int i;
-
-	if ((fp = fopen("x.out", "w")) == NULL) {
-		fprintf(stderr, "Faield to write output file %s!\n", "x.out");
-		exit(1);
-	}
-
-	for (i = 0; i < n; i++) {
-		fprintf(fp, "%e\n", x[i]);
-	}
-
-	fclose(fp);
-
+	/* Write the solution vector as configured by CG_OUTPUT */
+	outputTime = getWTime();
+	writeVector(config.outputFile, xOut, n, config.outputFormat);
+	outputTime = getWTime() - outputTime;
 
+	/* Check how much of the large arrays got huge pages */
+	hugePageUsage(&totalBytes, &hugeBytes);
+	snprintf(hugePages, sizeof(hugePages), "%.1f of %.1f MiB",
+	    hugeBytes / 1048576.0, totalBytes / 1048576.0);
 
 	/* Clean up */
-	free(b);
-	free(x);
+	strcpy(format, T != NULL ? T->name : A->format);
+	strcpy(precond, M != NULL ? M->name : "none");
+	destroyWorkspace(ws);
+	destroyPreconditioner(M);
+	if (T != NULL)
+		destroyTaskMatrix(T);
+	destroyOperator(A);
+	freeLarge(b);
+	freeLarge(x);
+	if (perm != NULL) {
+		freeLarge(xOut);
+		free(perm);
+	}
 	destroyMatrix(data, indices, length);
 
 	totalTime = getWTime() - totalTime;
@@ -216,7 +349,7 @@ int main(int argc, char *argv[]){
 	/* Print out some information */
 	output(
 	    argv,
-	    "NNZ", 'i', nnz,
+	    "NNZ", 'l', (long long)nnz,
 	    "N", 'i', n,
 	    "Max. iterations", 'i', sc.maxIter,
 	    "Tolerance", 'e', sc.tolerance,
@@ -227,12 +360,24 @@ int main(int argc, char *argv[]){
 	    /* Hint: Refer to solve.c and think about how many opertions */
 	    /*       are done in the innmost loop and how often this is done.*/
 	    "Hotspot GFLOP/s", 'f', ((2.0 * ((double)nnz) * ((double)(sc.iter+1))) / (sc.timeMatvec * 1000000000.0)),
+	    "Precond. time", 'f', sc.timePrecond,
 	    "IO time", 'f', ioTime,
 	    "Solve time", 'f', solveTime,
+	    "Output time", 'f', outputTime,
 	    "Total time", 'f', totalTime,
+	    "Huge pages", 's', hugePages,
+	    "NUMA domains", 'i', domains,
+	    "Kernel", 's', kernelName(),
+	    "Format", 's', format,
+	    "Preconditioner", 's', precond,
+	    "Remote x accesses", 's', remote,
 			"RESULT CHECK", 's', correct == 0 ? "ERROR" : "OK", 
 	    (const char*)NULL
 	);
 
+	/* Show how well the work-stealing schedule balanced the load */
+	if (config.schedule == SCHEDULE_STEAL)
+		stealReport();
+
 	return 0;
 }
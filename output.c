@@ -37,6 +37,9 @@
 	case 'i':						\
 		(void)va_arg(ap2, int);				\
 		break;						\
+	case 'l':						\
+		(void)va_arg(ap2, long long);			\
+		break;						\
 	case 'e':						\
 	case 'f':						\
 	case 'g':						\
@@ -56,6 +59,9 @@
 	case 'i':						\
 		line(longest, name, type, va_arg(ap, int));	\
 		break;						\
+	case 'l':						\
+		line(longest, name, type, va_arg(ap, long long)); \
+		break;						\
 	case 'e':						\
 	case 'f':						\
 	case 'g':						\
@@ -82,6 +88,9 @@ line(size_t width, const char *name, char type, ...)
 	case 'i':
 		printf("%d\n", va_arg(ap, int));
 		break;
+	case 'l':
+		printf("%lld\n", va_arg(ap, long long));
+		break;
 	case 'e':
 		printf("%.0le\n", va_arg(ap, double));
 		break;
@@ -0,0 +1,178 @@
+/*****************************************************
+ * CG Solver (HPC Software Lab)
+ *
+ * Parallel Programming Models for Applications in the 
+ * Area of High-Performance Computation
+ *====================================================
+ * Operator with packed column indices
+ *****************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "packed.h"
+#include "alloc.h"
+
+/* Read the code of entry e of a chunk with codes of width bytes */
+static inline unsigned int packedCode(const uint8_t* codes, const offsetType e, const int width){
+	uint16_t u16;
+	uint32_t u32;
+
+	switch (width) {
+	case 1:
+		return codes[e];
+	case 2:
+		memcpy(&u16, codes + 2 * e, sizeof(u16));
+		return u16;
+	default:
+		memcpy(&u32, codes + 4 * e, sizeof(u32));
+		return u32;
+	}
+}
+
+/* y <- A*x for the rows of chunk c */
+void matvecPackedChunk(const struct PackedMatrix* P, const int c, const floatType* x, floatType* y){
+	const int first = c * PACK_ROWS;
+	const int rows = (P->n - first < PACK_ROWS) ? P->n - first : PACK_ROWS;
+	const floatType* values = P->values + P->start[c];
+	const uint8_t* codes = P->codes + P->codeStart[c];
+	floatType sum[PACK_ROWS];
+	int j, l;
+
+	for (l = 0; l < rows; l++)
+		sum[l] = 0.0;
+	for (j = 0; j < P->length[c]; j++) {
+		for (l = 0; l < rows; l++) {
+			sum[l] += values[j * PACK_ROWS + l]
+			    * x[first + l + P->base[c] + (int)packedCode(codes, j * PACK_ROWS + l, P->width[c])];
+		}
+	}
+	for (l = 0; l < rows; l++)
+		y[first + l] = sum[l];
+}
+
+/* y <- A*x */
+void matvecPackedScalar(const struct PackedMatrix* P, const floatType* x, floatType* y){
+	int c;
+#pragma omp parallel for num_threads(threads) private(c)
+	for (c = 0; c < P->chunks; c++)
+		matvecPackedChunk(P, c, x, y);
+}
+
+static void applyPacked(const struct Operator* A, const floatType* x, floatType* y){
+	matvecPacked((const struct PackedMatrix*)A->state, x, y);
+}
+
+static void destroyPacked(struct Operator* A){
+	struct PackedMatrix* P = (struct PackedMatrix*)A->state;
+	free(P->length);
+	free(P->width);
+	free(P->base);
+	free(P->start);
+	free(P->codeStart);
+	freeLarge(P->values);
+	freeLarge(P->codes);
+	free(P);
+}
+
+/* Create an operator which stores the column indices of the
+ * ELLPACK-R matrix as distances to the row, in the fewest bytes
+ * that hold all distances of a chunk. The arrays are copied. */
+struct Operator* createPackedOperator(const int n, const offsetType nnz, const int maxNNZ, const floatType* data, const int* indices, const int* length){
+	struct Operator* A;
+	struct PackedMatrix* P;
+	offsetType entries, bytes, k, e;
+	long long lo, hi, d;
+	int c, i, j, l, first, rows;
+
+	A = (struct Operator*)malloc(sizeof(struct Operator));
+	P = (struct PackedMatrix*)malloc(sizeof(struct PackedMatrix));
+	if (A == NULL || P == NULL) {
+		puts("Out of memory!");
+		fatalError();
+	}
+
+	P->n = n;
+	P->chunks = (n + PACK_ROWS - 1) / PACK_ROWS;
+	P->length = (int*)malloc(sizeof(int) * (P->chunks + 1));
+	P->width = (int*)malloc(sizeof(int) * (P->chunks + 1));
+	P->base = (int*)malloc(sizeof(int) * (P->chunks + 1));
+	P->start = (offsetType*)malloc(sizeof(offsetType) * (P->chunks + 1));
+	P->codeStart = (offsetType*)malloc(sizeof(offsetType) * (P->chunks + 1));
+	if (P->length == NULL || P->width == NULL || P->base == NULL || P->start == NULL || P->codeStart == NULL) {
+		puts("Out of memory!");
+		fatalError();
+	}
+
+	/* Length, range of the distances and code width of each chunk.
+	 * The distance 0 of the padding is always in the range. */
+#pragma omp parallel for num_threads(threads) private(c, i, j, first, rows, lo, hi, d)
+	for (c = 0; c < P->chunks; c++) {
+		first = c * PACK_ROWS;
+		rows = (n - first < PACK_ROWS) ? n - first : PACK_ROWS;
+		P->length[c] = 0;
+		lo = hi = 0;
+		for (i = first; i < first + rows; i++) {
+			if (length[i] > P->length[c])
+				P->length[c] = length[i];
+			for (j = 0; j < length[i]; j++) {
+				d = (long long)indices[(offsetType)j * n + i] - i;
+				if (d < lo)
+					lo = d;
+				if (d > hi)
+					hi = d;
+			}
+		}
+		P->base[c] = (int)lo;
+		P->width[c] = (hi - lo < 256) ? 1 : (hi - lo < 65536) ? 2 : 4;
+	}
+
+	entries = bytes = 0;
+	for (c = 0; c < P->chunks; c++) {
+		P->start[c] = entries;
+		P->codeStart[c] = bytes;
+		entries += (offsetType)P->length[c] * PACK_ROWS;
+		bytes += (offsetType)P->length[c] * PACK_ROWS * P->width[c];
+	}
+	P->values = (floatType*)allocLarge(sizeof(floatType) * entries);
+	P->codes = (uint8_t*)allocLarge(bytes + 4);
+
+	/* Encode the chunks, with the same partition as the kernels */
+#pragma omp parallel for num_threads(threads) private(c, j, l, i, k, e, d)
+	for (c = 0; c < P->chunks; c++) {
+		for (j = 0; j < P->length[c]; j++) {
+			for (l = 0; l < PACK_ROWS; l++) {
+				i = c * PACK_ROWS + l;
+				e = j * PACK_ROWS + l;
+				k = (offsetType)j * n + i;
+				if (i < n && j < length[i]) {
+					P->values[P->start[c] + e] = data[k];
+					d = (long long)indices[k] - i - P->base[c];
+				} else {
+					P->values[P->start[c] + e] = 0.0;
+					d = -(long long)P->base[c];
+				}
+				if (P->width[c] == 1) {
+					P->codes[P->codeStart[c] + e] = (uint8_t)d;
+				} else if (P->width[c] == 2) {
+					uint16_t u16 = (uint16_t)d;
+					memcpy(P->codes + P->codeStart[c] + 2 * e, &u16, sizeof(u16));
+				} else {
+					uint32_t u32 = (uint32_t)d;
+					memcpy(P->codes + P->codeStart[c] + 4 * e, &u32, sizeof(u32));
+				}
+			}
+		}
+	}
+
+	snprintf(A->format, sizeof(A->format), "packed indices, %.2f bytes per index", entries > 0 ? (double)bytes / entries : 0.0);
+	A->n = n;
+	A->nnz = nnz;
+	A->diag = NULL;
+	A->apply = applyPacked;
+	A->destroy = destroyPacked;
+	A->state = P;
+	return A;
+}
@@ -0,0 +1,52 @@
+/*****************************************************
+ * CG Solver (HPC Software Lab)
+ *
+ * Parallel Programming Models for Applications in the 
+ * Area of High-Performance Computation
+ *====================================================
+ * Operator with packed column indices
+ *****************************************************/
+
+
+#ifndef __PACKED_H__
+#define __PACKED_H__
+
+#include <stdint.h>
+
+#include "def.h"
+#include "solver.h"
+
+/* Rows per chunk, one row per lane of an AVX-512 vector */
+#define PACK_ROWS 8
+
+/* The ELLPACK-R matrix cut into chunks of PACK_ROWS rows. Chunk c
+ * holds the rows c*PACK_ROWS, ... and is padded to its longest row,
+ * length[c] entries. The j-th entries of its rows are stored next
+ * to each other, from values[start[c]] on. The column of an entry
+ * of row i is i + base[c] + u, where u is the unsigned integer of
+ * width[c] bytes (1, 2 or 4) at the same position of the codes,
+ * which start at byte codeStart[c]. Padding entries point to the
+ * diagonal and are zero. */
+struct PackedMatrix {
+	int n;
+	int chunks;
+	int* length;
+	int* width;
+	int* base;
+	offsetType* start;
+	offsetType* codeStart;
+	floatType* values;
+	uint8_t* codes;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+void matvecPackedChunk(const struct PackedMatrix* P, const int c, const floatType* x, floatType* y);
+void matvecPackedScalar(const struct PackedMatrix* P, const floatType* x, floatType* y);
+struct Operator* createPackedOperator(const int n, const offsetType nnz, const int maxNNZ, const floatType* data, const int* indices, const int* length);
+#ifdef __cplusplus
+}
+#endif
+
+#endif
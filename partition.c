@@ -0,0 +1,213 @@
+/*****************************************************
+ * CG Solver (HPC Software Lab)
+ *
+ * Parallel Programming Models for Applications in the 
+ * Area of High-Performance Computation
+ *====================================================
+ * Renumbering of the matrix for NUMA domains
+ *****************************************************/
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(_WIN32) && !defined(_WIN64)
+# include <dirent.h>
+#endif
+
+#include "partition.h"
+#include "solver.h"
+#include "alloc.h"
+#include "io.h"
+
+/* Return the number of NUMA domains of the machine. It can be set
+ * with CG_NUMA_DOMAINS, otherwise the nodes in sysfs are counted. */
+int numaDomains(void){
+	int domains = 0;
+#if !defined(_WIN32) && !defined(_WIN64)
+	DIR* dir;
+	struct dirent* entry;
+#endif
+
+	if (config.numaDomains > 0)
+		return config.numaDomains;
+
+#if !defined(_WIN32) && !defined(_WIN64)
+	if ((dir = opendir("/sys/devices/system/node")) != NULL) {
+		while ((entry = readdir(dir)) != NULL) {
+			if (!strncmp(entry->d_name, "node", 4) &&
+			    entry->d_name[4] >= '0' && entry->d_name[4] <= '9')
+				domains++;
+		}
+		closedir(dir);
+	}
+#endif
+
+	return (domains > 0) ? domains : 1;
+}
+
+/* Breadth first search from the vertex start over all vertices
+ * with mark[v] != stamp. Returns the vertex visited last, which is
+ * one of the vertices farthest away from start. */
+static int farthestVertex(const int n, const int* indices, const int* length, const int start, int* queue, int* mark, const int stamp){
+	int head = 0, tail = 0, v, u, j;
+
+	queue[tail++] = start;
+	mark[start] = stamp;
+	while (head < tail) {
+		v = queue[head++];
+		for (j = 0; j < length[v]; j++) {
+			u = indices[(offsetType)j * n + v];
+			if (mark[u] != stamp && mark[u] >= 0) {
+				mark[u] = stamp;
+				queue[tail++] = u;
+			}
+		}
+	}
+
+	return queue[tail - 1];
+}
+
+/* Partition the graph of the n x n ELLPACK-R matrix by numbering
+ * the vertices in breadth first order, starting from a pseudo-
+ * peripheral vertex in every connected component. Cutting this
+ * order into consecutive blocks of equal size, one per NUMA domain,
+ * gives slices of the level structure (as in Cuthill-McKee): the
+ * neighbors of a vertex are in the same block or in an adjacent one,
+ * so only the vertices next to a cut are accessed remotely.
+ * perm[i] is the old number of the vertex with the new number i. */
+void partitionGraph(const int n, const int* indices, const int* length, int* perm){
+	int *mark, *queue;
+	int head = 0, tail = 0, next = 0, stamp = 1, seed, v, u, j;
+
+	mark = (int*)calloc(n, sizeof(int));
+	queue = (int*)malloc(sizeof(int) * n);
+	if (mark == NULL || queue == NULL) {
+		puts("Out of memory!");
+		fatalError();
+	}
+
+	/* Numbered vertices are marked with -1 */
+	while (tail < n) {
+		/* Start a new component from a pseudo-peripheral vertex */
+		while (mark[next] < 0)
+			next++;
+		seed = farthestVertex(n, indices, length, next, queue, mark, ++stamp);
+		seed = farthestVertex(n, indices, length, seed, queue, mark, ++stamp);
+
+		mark[seed] = -1;
+		perm[tail++] = seed;
+		while (head < tail) {
+			v = perm[head++];
+			for (j = 0; j < length[v]; j++) {
+				u = indices[(offsetType)j * n + v];
+				if (mark[u] >= 0) {
+					mark[u] = -1;
+					perm[tail++] = u;
+				}
+			}
+		}
+	}
+
+	free(mark);
+	free(queue);
+}
+
+/* Renumber rows and columns of the n x n ELLPACK-R matrix with the
+ * permutation perm, so that row i of the new matrix is row perm[i]
+ * of the old one. The new arrays are filled by the threads that
+ * later work on the rows. */
+void permuteMatrix(const int n, const int maxNNZ, floatType** data, int** indices, int** length, const int* perm){
+	floatType* newData;
+	int *newIndices, *newLength, *iperm;
+	int i, j;
+	offsetType k, l;
+
+	if ((iperm = (int*)malloc(sizeof(int) * n)) == NULL) {
+		puts("Out of memory!");
+		fatalError();
+	}
+	for (i = 0; i < n; i++)
+		iperm[perm[i]] = i;
+
+	newData = (floatType*)allocLarge(sizeof(floatType) * (size_t)n * maxNNZ);
+	newIndices = (int*)allocLarge(sizeof(int) * (size_t)n * maxNNZ);
+	newLength = (int*)allocLarge(sizeof(int) * n);
+
+#pragma omp parallel for num_threads(threads) private(i, j, k, l)
+	for (i = 0; i < n; i++) {
+		newLength[i] = (*length)[perm[i]];
+		for (j = 0; j < maxNNZ; j++) {
+			k = (offsetType)j * n + i;
+			l = (offsetType)j * n + perm[i];
+			newData[k] = (*data)[l];
+			newIndices[k] = (j < newLength[i]) ? iperm[(*indices)[l]] : 0;
+		}
+	}
+
+	destroyMatrix(*data, *indices, *length);
+	*data = newData;
+	*indices = newIndices;
+	*length = newLength;
+
+	free(iperm);
+}
+
+/* y <- P*x, i.e. y[i] = x[perm[i]] */
+void permuteVector(const int n, const int* perm, const floatType* x, floatType* y){
+	int i;
+#pragma omp parallel for num_threads(threads) private(i)
+	for (i = 0; i < n; i++) {
+		y[i] = x[perm[i]];
+	}
+}
+
+/* y <- P'*x, i.e. y[perm[i]] = x[i] */
+void unpermuteVector(const int n, const int* perm, const floatType* x, floatType* y){
+	int i;
+#pragma omp parallel for num_threads(threads) private(i)
+	for (i = 0; i < n; i++) {
+		y[perm[i]] = x[i];
+	}
+}
+
+/* Return the fraction of x accesses in the matrix vector product
+ * which go to another NUMA domain if the matrix is renumbered with
+ * perm (NULL for the current order). The rows are assumed to be
+ * split into domains consecutive blocks of equal size, as it is
+ * done by the static schedule when the threads are spread evenly
+ * over the domains, and x[j] lives in the domain of row j. */
+double remoteAccesses(const int n, const int* indices, const int* length, const int domains, const int* perm){
+	offsetType remote = 0, total = 0;
+	int *iperm = NULL;
+	int i, j, row, col;
+
+	if (perm != NULL) {
+		if ((iperm = (int*)malloc(sizeof(int) * n)) == NULL) {
+			puts("Out of memory!");
+			fatalError();
+		}
+		for (i = 0; i < n; i++)
+			iperm[perm[i]] = i;
+	}
+
+#pragma omp parallel for num_threads(threads) private(i, j, row, col) reduction(+:remote, total)
+	for (i = 0; i < n; i++) {
+		int domain = (int)((long long)i * domains / n);
+		row = (perm != NULL) ? perm[i] : i;
+		for (j = 0; j < length[row]; j++) {
+			col = indices[(offsetType)j * n + row];
+			if (iperm != NULL)
+				col = iperm[col];
+			if ((int)((long long)col * domains / n) != domain)
+				remote++;
+		}
+		total += length[row];
+	}
+
+	free(iperm);
+
+	return (total > 0) ? (double)remote / total : 0.0;
+}
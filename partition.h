@@ -0,0 +1,30 @@
+/*****************************************************
+ * CG Solver (HPC Software Lab)
+ *
+ * Parallel Programming Models for Applications in the 
+ * Area of High-Performance Computation
+ *====================================================
+ * Renumbering of the matrix for NUMA domains
+ *****************************************************/
+
+
+
+#ifndef __PARTITION_H__
+#define __PARTITION_H__
+
+#include "def.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+int numaDomains(void);
+void partitionGraph(const int n, const int* indices, const int* length, int* perm);
+void permuteMatrix(const int n, const int maxNNZ, floatType** data, int** indices, int** length, const int* perm);
+void permuteVector(const int n, const int* perm, const floatType* x, floatType* y);
+void unpermuteVector(const int n, const int* perm, const floatType* x, floatType* y);
+double remoteAccesses(const int n, const int* indices, const int* length, const int domains, const int* perm);
+#ifdef __cplusplus
+}
+#endif
+
+#endif
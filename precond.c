@@ -0,0 +1,138 @@
+/*****************************************************
+ * CG Solver (HPC Software Lab)
+ *
+ * Parallel Programming Models for Applications in the 
+ * Area of High-Performance Computation
+ *====================================================
+ * Preconditioners of cg()
+ *****************************************************/
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "precond.h"
+#include "ssor.h"
+#include "chebyshev.h"
+#include "amg.h"
+#include "alloc.h"
+
+/* Store the diagonal of the ELLPACK-R matrix in diag. Every row
+ * must have a nonzero diagonal entry for the preconditioners. */
+void extractDiagonal(const int n, const floatType* data, const int* indices, const int* length, floatType* diag){
+	int i, j, missing = -1;
+	offsetType k;
+
+#pragma omp parallel for num_threads(threads) private(i, j, k) reduction(max:missing)
+	for (i = 0; i < n; i++) {
+		diag[i] = 0.0;
+		for (j = 0; j < length[i]; j++) {
+			k = (offsetType)j * n + i;
+			if (indices[k] == i)
+				diag[i] += data[k];
+		}
+		if (diag[i] == 0.0 && i > missing)
+			missing = i;
+	}
+
+	if (missing >= 0) {
+		printf("ERROR: Row %d has no diagonal entry, it cannot be preconditioned!\n", missing);
+		fatalError();
+	}
+}
+
+
+/* Jacobi: z <- D^-1 * r with the inverted diagonal in state */
+static void applyJacobi(const struct Preconditioner* M, const floatType* r, floatType* z){
+	const floatType* invDiag = (const floatType*)M->state;
+	const int n = M->n;
+	int i;
+
+#pragma omp parallel for num_threads(threads) private(i)
+	for (i = 0; i < n; i++) {
+		z[i] = invDiag[i] * r[i];
+	}
+}
+
+static void destroyJacobi(struct Preconditioner* M){
+	freeLarge(M->state);
+}
+
+/* Create the Jacobi preconditioner with the diagonal of the
+ * operator if it has one, otherwise with the one of the matrix. */
+static struct Preconditioner* createJacobiPreconditioner(const struct Operator* A, const floatType* data, const int* indices, const int* length){
+	struct Preconditioner* M;
+	floatType* invDiag;
+	const int n = A->n;
+	int i;
+
+	if (A->diag == NULL && data == NULL) {
+		printf("WARNING: The operator has no diagonal, running without preconditioner.\n");
+		return NULL;
+	}
+
+	M = (struct Preconditioner*)malloc(sizeof(struct Preconditioner));
+	if (M == NULL) {
+		puts("Out of memory!");
+		fatalError();
+	}
+	invDiag = (floatType*)allocLarge(sizeof(floatType) * n);
+
+	if (A->diag != NULL) {
+#pragma omp parallel for num_threads(threads) private(i)
+		for (i = 0; i < n; i++) {
+			invDiag[i] = A->diag[i];
+		}
+	} else {
+		extractDiagonal(n, data, indices, length, invDiag);
+	}
+#pragma omp parallel for num_threads(threads) private(i)
+	for (i = 0; i < n; i++) {
+		invDiag[i] = 1.0 / invDiag[i];
+	}
+
+	snprintf(M->name, sizeof(M->name), "Jacobi");
+	M->n = n;
+	M->apply = applyJacobi;
+	M->destroy = destroyJacobi;
+	M->state = invDiag;
+	return M;
+}
+
+
+/* Create the preconditioner of CG_PRECOND for the operator A. The
+ * preconditioners which need the entries of the matrix take them
+ * from the ELLPACK-R arrays, which must stay valid as long as the
+ * preconditioner is used. data is NULL if A is only given as an
+ * operator. NULL is returned for no preconditioning. */
+struct Preconditioner* createPreconditioner(const struct Operator* A, const int maxNNZ, const floatType* data, const int* indices, const int* length){
+	switch (config.precond) {
+	case PRECOND_JACOBI:
+		return createJacobiPreconditioner(A, data, indices, length);
+	case PRECOND_SSOR:
+		if (data == NULL) {
+			printf("WARNING: SSOR needs the entries of the matrix, running without preconditioner.\n");
+			return NULL;
+		}
+		return createSSORPreconditioner(A->n, maxNNZ, data, indices, length, config.omega);
+	case PRECOND_AMG:
+		if (data == NULL) {
+			printf("WARNING: AMG needs the entries of the matrix, running without preconditioner.\n");
+			return NULL;
+		}
+		return createAMGPreconditioner(A, data, indices, length);
+	case PRECOND_CHEBYSHEV:
+		return createChebyshevPreconditioner(A, config.degree);
+	default:
+		return NULL;
+	}
+}
+
+/* Free a preconditioner, NULL is ignored */
+void destroyPreconditioner(struct Preconditioner* M){
+	if (M == NULL)
+		return;
+	M->destroy(M);
+	free(M);
+}
@@ -0,0 +1,27 @@
+/*****************************************************
+ * CG Solver (HPC Software Lab)
+ *
+ * Parallel Programming Models for Applications in the 
+ * Area of High-Performance Computation
+ *====================================================
+ * Preconditioners of cg()
+ *****************************************************/
+
+
+#ifndef __PRECOND_H__
+#define __PRECOND_H__
+
+#include "def.h"
+#include "solver.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+void extractDiagonal(const int n, const floatType* data, const int* indices, const int* length, floatType* diag);
+struct Preconditioner* createPreconditioner(const struct Operator* A, const int maxNNZ, const floatType* data, const int* indices, const int* length);
+void destroyPreconditioner(struct Preconditioner* M);
+#ifdef __cplusplus
+}
+#endif
+
+#endif
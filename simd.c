@@ -0,0 +1,515 @@
+/*****************************************************
+ * CG Solver (HPC Software Lab)
+ *
+ * Parallel Programming Models for Applications in the 
+ * Area of High-Performance Computation
+ *====================================================
+ * AVX2 and AVX-512 kernels
+ *****************************************************/
+
+
+#include <stdlib.h>
+#include <math.h>
+
+#include "simd.h"
+#include "solver.h"
+#include "packed.h"
+
+#ifdef HAVE_SIMD_KERNELS
+
+#include <immintrin.h>
+
+/* Ask cpuid whether the kernels below can run on this processor */
+int cpuHasAVX2(void){
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+}
+
+int cpuHasAVX512(void){
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx512f");
+}
+
+
+/***************************************
+ *                AVX2                 *
+ ***************************************/
+
+/* Sum of the four lanes of a */
+__attribute__((target("avx2,fma")))
+static inline double hsum256(__m256d a){
+	__m128d s = _mm_add_pd(_mm256_castpd256_pd128(a), _mm256_extractf128_pd(a, 1));
+	return _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+}
+
+/* ab <- a' * b */
+__attribute__((target("avx2,fma")))
+static void vectorDotAVX2(const floatType* a, const floatType* b, const int n, floatType* ab){
+	int i, blocks = n / 8;
+	floatType temp = 0;
+#pragma omp parallel num_threads(threads) private(i) reduction(+:temp)
+	{
+		__m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+#pragma omp for
+		for (i = 0; i < blocks; i++) {
+			s0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + 8*i), _mm256_loadu_pd(b + 8*i), s0);
+			s1 = _mm256_fmadd_pd(_mm256_loadu_pd(a + 8*i + 4), _mm256_loadu_pd(b + 8*i + 4), s1);
+		}
+		temp += hsum256(_mm256_add_pd(s0, s1));
+	}
+	for (i = 8 * blocks; i < n; i++)
+		temp += a[i] * b[i];
+	*ab = temp;
+}
+
+/* a' * b for one block of a reproducible reduction */
+__attribute__((target("avx2,fma")))
+static floatType blockDotAVX2(const floatType* a, const floatType* b, const int n){
+	__m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+	floatType temp;
+	int i;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		s0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i), s0);
+		s1 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4), s1);
+	}
+	temp = hsum256(_mm256_add_pd(s0, s1));
+	for (; i < n; i++)
+		temp += a[i] * b[i];
+	return temp;
+}
+
+/* y <- ax + y */
+__attribute__((target("avx2,fma")))
+static void axpyAVX2(const floatType a, const floatType* x, const int n, floatType* y){
+	int i, blocks = n / 4;
+	__m256d va = _mm256_set1_pd(a);
+#pragma omp parallel for num_threads(threads) private(i)
+	for (i = 0; i < blocks; i++)
+		_mm256_storeu_pd(y + 4*i, _mm256_fmadd_pd(va, _mm256_loadu_pd(x + 4*i), _mm256_loadu_pd(y + 4*i)));
+	for (i = 4 * blocks; i < n; i++)
+		y[i] = a * x[i] + y[i];
+}
+
+/* y <- x + ay */
+__attribute__((target("avx2,fma")))
+static void xpayAVX2(const floatType* x, const floatType a, const int n, floatType* y){
+	int i, blocks = n / 4;
+	__m256d va = _mm256_set1_pd(a);
+#pragma omp parallel for num_threads(threads) private(i)
+	for (i = 0; i < blocks; i++)
+		_mm256_storeu_pd(y + 4*i, _mm256_fmadd_pd(va, _mm256_loadu_pd(y + 4*i), _mm256_loadu_pd(x + 4*i)));
+	for (i = 4 * blocks; i < n; i++)
+		y[i] = x[i] + a * y[i];
+}
+
+/* y <- A*x
+ * In the column-major ELLPACK-R layout the j-th entries of the
+ * rows i, ..., i+3 are stored next to each other, so each lane
+ * works on one row and fetches its x values with one gather.
+ * Rows shorter than the longest row of the group read the zero
+ * padding, whose column index is valid. */
+__attribute__((target("avx2,fma")))
+static void matvecAVX2(const int n, const offsetType nnz, const int maxNNZ, const floatType* data, const int* indices, const int* length, const floatType* x, floatType* y){
+	int b, i, j, len, blocks = n / 4;
+	offsetType k;
+#pragma omp parallel for num_threads(threads) private(b, i, j, k, len)
+	for (b = 0; b < blocks; b++) {
+		__m256d sum = _mm256_setzero_pd();
+		i = 4 * b;
+		len = length[i];
+		for (j = 1; j < 4; j++)
+			if (length[i + j] > len)
+				len = length[i + j];
+		for (j = 0; j < len; j++) {
+			k = (offsetType)j * n + i;
+			sum = _mm256_fmadd_pd(_mm256_loadu_pd(data + k),
+			    _mm256_i32gather_pd(x, _mm_loadu_si128((const __m128i*)(indices + k)), 8), sum);
+		}
+		_mm256_storeu_pd(y + i, sum);
+	}
+	for (i = 4 * blocks; i < n; i++) {
+		y[i] = 0.0;
+		for (j = 0; j < length[i]; j++) {
+			k = (offsetType)j * n + i;
+			y[i] += data[k] * x[indices[k]];
+		}
+	}
+}
+
+/* y <- A*x for the rows first ... last-1 only, by the calling
+ * thread (see matvecAVX2) */
+__attribute__((target("avx2,fma")))
+static void matvecRangeAVX2(const int n, const int first, const int last, const floatType* data, const int* indices, const int* length, const floatType* x, floatType* y){
+	int i, j, r, len;
+	offsetType k;
+	for (i = first; i + 4 <= last; i += 4) {
+		__m256d sum = _mm256_setzero_pd();
+		len = length[i];
+		for (r = 1; r < 4; r++)
+			if (length[i + r] > len)
+				len = length[i + r];
+		for (j = 0; j < len; j++) {
+			k = (offsetType)j * n + i;
+			sum = _mm256_fmadd_pd(_mm256_loadu_pd(data + k),
+			    _mm256_i32gather_pd(x, _mm_loadu_si128((const __m128i*)(indices + k)), 8), sum);
+		}
+		_mm256_storeu_pd(y + i, sum);
+	}
+	for (; i < last; i++) {
+		y[i] = 0.0;
+		for (j = 0; j < length[i]; j++) {
+			k = (offsetType)j * n + i;
+			y[i] += data[k] * x[indices[k]];
+		}
+	}
+}
+
+/* y <- A*x for rows with at most W entries (see matvecAVX2), for
+ * all rows or the rows first ... last-1. The loops over the entries of a row have a constant trip count
+ * and are unrolled completely, length is not read at all. All
+ * gathers are issued first, so none of them waits for a register
+ * still used by the chain of multiply-adds. */
+#define MATVEC_FIXED_AVX2(W) \
+__attribute__((target("avx2,fma"))) \
+static void matvecFixed##W##AVX2(const int n, const floatType* data, const int* indices, const floatType* x, floatType* y){ \
+	int b, i, j, blocks = n / 4; \
+	offsetType k; \
+	_Pragma("omp parallel for num_threads(threads) private(b, i, j, k)") \
+	for (b = 0; b < blocks; b++) { \
+		__m256d sum = _mm256_setzero_pd(), g[W]; \
+		i = 4 * b; \
+		FIXED_UNROLL \
+		for (j = 0; j < W; j++) \
+			g[j] = _mm256_i32gather_pd(x, _mm_loadu_si128((const __m128i*)(indices + (offsetType)j * n + i)), 8); \
+		FIXED_UNROLL \
+		for (j = 0; j < W; j++) { \
+			k = (offsetType)j * n + i; \
+			sum = _mm256_fmadd_pd(_mm256_loadu_pd(data + k), g[j], sum); \
+		} \
+		_mm256_storeu_pd(y + i, sum); \
+	} \
+	for (i = 4 * blocks; i < n; i++) { \
+		y[i] = 0.0; \
+		for (j = 0; j < W; j++) { \
+			k = (offsetType)j * n + i; \
+			y[i] += data[k] * x[indices[k]]; \
+		} \
+	} \
+} \
+__attribute__((target("avx2,fma"))) \
+static void matvecFixed##W##RangeAVX2(const int n, const int first, const int last, const floatType* data, const int* indices, const floatType* x, floatType* y){ \
+	int i, j; \
+	offsetType k; \
+	for (i = first; i + 4 <= last; i += 4) { \
+		__m256d sum = _mm256_setzero_pd(), g[W]; \
+		FIXED_UNROLL \
+		for (j = 0; j < W; j++) \
+			g[j] = _mm256_i32gather_pd(x, _mm_loadu_si128((const __m128i*)(indices + (offsetType)j * n + i)), 8); \
+		FIXED_UNROLL \
+		for (j = 0; j < W; j++) { \
+			k = (offsetType)j * n + i; \
+			sum = _mm256_fmadd_pd(_mm256_loadu_pd(data + k), g[j], sum); \
+		} \
+		_mm256_storeu_pd(y + i, sum); \
+	} \
+	for (; i < last; i++) { \
+		y[i] = 0.0; \
+		for (j = 0; j < W; j++) { \
+			k = (offsetType)j * n + i; \
+			y[i] += data[k] * x[indices[k]]; \
+		} \
+	} \
+}
+
+MATVEC_FIXED_AVX2(3)
+MATVEC_FIXED_AVX2(5)
+MATVEC_FIXED_AVX2(7)
+MATVEC_FIXED_AVX2(9)
+MATVEC_FIXED_AVX2(27)
+
+/* nrm <- ||x||_2 */
+__attribute__((target("avx2,fma")))
+static void nrm2AVX2(const floatType* x, const int n, floatType* nrm){
+	floatType temp;
+	vectorDotAVX2(x, x, n, &temp);
+	*nrm = sqrt(temp);
+}
+
+/* y <- A*x with packed column indices. The codes of the j-th
+ * entries of the eight rows of a chunk are widened to 32 bit and
+ * added to the row numbers, which gives the indices of the gathers. */
+__attribute__((target("avx2,fma")))
+static void matvecPackedAVX2(const struct PackedMatrix* P, const floatType* x, floatType* y){
+	const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	const int full = P->n / PACK_ROWS;
+	int c, j;
+
+#pragma omp parallel for num_threads(threads) private(c, j)
+	for (c = 0; c < full; c++) {
+		const floatType* values = P->values + P->start[c];
+		const uint8_t* codes = P->codes + P->codeStart[c];
+		const __m256i row = _mm256_add_epi32(_mm256_set1_epi32(c * PACK_ROWS + P->base[c]), lanes);
+		__m256d lo = _mm256_setzero_pd(), hi = _mm256_setzero_pd();
+		__m256i idx;
+
+		for (j = 0; j < P->length[c]; j++) {
+			if (P->width[c] == 1)
+				idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(codes + j * PACK_ROWS)));
+			else if (P->width[c] == 2)
+				idx = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(codes + 2 * j * PACK_ROWS)));
+			else
+				idx = _mm256_loadu_si256((const __m256i*)(codes + 4 * j * PACK_ROWS));
+			idx = _mm256_add_epi32(idx, row);
+			lo = _mm256_fmadd_pd(_mm256_loadu_pd(values + j * PACK_ROWS),
+			    _mm256_i32gather_pd(x, _mm256_castsi256_si128(idx), 8), lo);
+			hi = _mm256_fmadd_pd(_mm256_loadu_pd(values + j * PACK_ROWS + 4),
+			    _mm256_i32gather_pd(x, _mm256_extracti128_si256(idx, 1), 8), hi);
+		}
+		_mm256_storeu_pd(y + c * PACK_ROWS, lo);
+		_mm256_storeu_pd(y + c * PACK_ROWS + 4, hi);
+	}
+	if (full < P->chunks)
+		matvecPackedChunk(P, full, x, y);
+}
+
+const struct Kernels avx2Kernels = {
+	"avx2", vectorDotAVX2, axpyAVX2, xpayAVX2, matvecAVX2, nrm2AVX2,
+	{matvecFixed3AVX2, matvecFixed5AVX2, matvecFixed7AVX2, matvecFixed9AVX2, matvecFixed27AVX2},
+	matvecPackedAVX2,
+	blockDotAVX2,
+	matvecRangeAVX2,
+	{matvecFixed3RangeAVX2, matvecFixed5RangeAVX2, matvecFixed7RangeAVX2, matvecFixed9RangeAVX2, matvecFixed27RangeAVX2}
+};
+
+
+/***************************************
+ *               AVX-512               *
+ ***************************************/
+
+/* ab <- a' * b */
+__attribute__((target("avx512f")))
+static void vectorDotAVX512(const floatType* a, const floatType* b, const int n, floatType* ab){
+	int i, blocks = n / 16;
+	floatType temp = 0;
+#pragma omp parallel num_threads(threads) private(i) reduction(+:temp)
+	{
+		__m512d s0 = _mm512_setzero_pd(), s1 = _mm512_setzero_pd();
+#pragma omp for
+		for (i = 0; i < blocks; i++) {
+			s0 = _mm512_fmadd_pd(_mm512_loadu_pd(a + 16*i), _mm512_loadu_pd(b + 16*i), s0);
+			s1 = _mm512_fmadd_pd(_mm512_loadu_pd(a + 16*i + 8), _mm512_loadu_pd(b + 16*i + 8), s1);
+		}
+		temp += _mm512_reduce_add_pd(_mm512_add_pd(s0, s1));
+	}
+	for (i = 16 * blocks; i < n; i++)
+		temp += a[i] * b[i];
+	*ab = temp;
+}
+
+/* a' * b for one block of a reproducible reduction */
+__attribute__((target("avx512f")))
+static floatType blockDotAVX512(const floatType* a, const floatType* b, const int n){
+	__m512d s0 = _mm512_setzero_pd(), s1 = _mm512_setzero_pd();
+	floatType temp;
+	int i;
+
+	for (i = 0; i + 16 <= n; i += 16) {
+		s0 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i), s0);
+		s1 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i + 8), _mm512_loadu_pd(b + i + 8), s1);
+	}
+	temp = _mm512_reduce_add_pd(_mm512_add_pd(s0, s1));
+	for (; i < n; i++)
+		temp += a[i] * b[i];
+	return temp;
+}
+
+/* y <- ax + y */
+__attribute__((target("avx512f")))
+static void axpyAVX512(const floatType a, const floatType* x, const int n, floatType* y){
+	int i, blocks = n / 8;
+	__m512d va = _mm512_set1_pd(a);
+#pragma omp parallel for num_threads(threads) private(i)
+	for (i = 0; i < blocks; i++)
+		_mm512_storeu_pd(y + 8*i, _mm512_fmadd_pd(va, _mm512_loadu_pd(x + 8*i), _mm512_loadu_pd(y + 8*i)));
+	for (i = 8 * blocks; i < n; i++)
+		y[i] = a * x[i] + y[i];
+}
+
+/* y <- x + ay */
+__attribute__((target("avx512f")))
+static void xpayAVX512(const floatType* x, const floatType a, const int n, floatType* y){
+	int i, blocks = n / 8;
+	__m512d va = _mm512_set1_pd(a);
+#pragma omp parallel for num_threads(threads) private(i)
+	for (i = 0; i < blocks; i++)
+		_mm512_storeu_pd(y + 8*i, _mm512_fmadd_pd(va, _mm512_loadu_pd(y + 8*i), _mm512_loadu_pd(x + 8*i)));
+	for (i = 8 * blocks; i < n; i++)
+		y[i] = x[i] + a * y[i];
+}
+
+/* y <- A*x, eight rows per vector (see matvecAVX2) */
+__attribute__((target("avx512f")))
+static void matvecAVX512(const int n, const offsetType nnz, const int maxNNZ, const floatType* data, const int* indices, const int* length, const floatType* x, floatType* y){
+	int b, i, j, len, blocks = n / 8;
+	offsetType k;
+#pragma omp parallel for num_threads(threads) private(b, i, j, k, len)
+	for (b = 0; b < blocks; b++) {
+		__m512d sum = _mm512_setzero_pd();
+		i = 8 * b;
+		len = length[i];
+		for (j = 1; j < 8; j++)
+			if (length[i + j] > len)
+				len = length[i + j];
+		for (j = 0; j < len; j++) {
+			k = (offsetType)j * n + i;
+			sum = _mm512_fmadd_pd(_mm512_loadu_pd(data + k),
+			    _mm512_i32gather_pd(_mm256_loadu_si256((const __m256i*)(indices + k)), x, 8), sum);
+		}
+		_mm512_storeu_pd(y + i, sum);
+	}
+	for (i = 8 * blocks; i < n; i++) {
+		y[i] = 0.0;
+		for (j = 0; j < length[i]; j++) {
+			k = (offsetType)j * n + i;
+			y[i] += data[k] * x[indices[k]];
+		}
+	}
+}
+
+/* y <- A*x for the rows first ... last-1 only, by the calling
+ * thread (see matvecAVX2) */
+__attribute__((target("avx512f")))
+static void matvecRangeAVX512(const int n, const int first, const int last, const floatType* data, const int* indices, const int* length, const floatType* x, floatType* y){
+	int i, j, r, len;
+	offsetType k;
+	for (i = first; i + 8 <= last; i += 8) {
+		__m512d sum = _mm512_setzero_pd();
+		len = length[i];
+		for (r = 1; r < 8; r++)
+			if (length[i + r] > len)
+				len = length[i + r];
+		for (j = 0; j < len; j++) {
+			k = (offsetType)j * n + i;
+			sum = _mm512_fmadd_pd(_mm512_loadu_pd(data + k),
+			    _mm512_i32gather_pd(_mm256_loadu_si256((const __m256i*)(indices + k)), x, 8), sum);
+		}
+		_mm512_storeu_pd(y + i, sum);
+	}
+	for (; i < last; i++) {
+		y[i] = 0.0;
+		for (j = 0; j < length[i]; j++) {
+			k = (offsetType)j * n + i;
+			y[i] += data[k] * x[indices[k]];
+		}
+	}
+}
+
+/* y <- A*x for rows with at most W entries (see MATVEC_FIXED_AVX2) */
+#define MATVEC_FIXED_AVX512(W) \
+__attribute__((target("avx512f"))) \
+static void matvecFixed##W##AVX512(const int n, const floatType* data, const int* indices, const floatType* x, floatType* y){ \
+	int b, i, j, blocks = n / 8; \
+	offsetType k; \
+	_Pragma("omp parallel for num_threads(threads) private(b, i, j, k)") \
+	for (b = 0; b < blocks; b++) { \
+		__m512d sum = _mm512_setzero_pd(), g[W]; \
+		i = 8 * b; \
+		FIXED_UNROLL \
+		for (j = 0; j < W; j++) \
+			g[j] = _mm512_i32gather_pd(_mm256_loadu_si256((const __m256i*)(indices + (offsetType)j * n + i)), x, 8); \
+		FIXED_UNROLL \
+		for (j = 0; j < W; j++) { \
+			k = (offsetType)j * n + i; \
+			sum = _mm512_fmadd_pd(_mm512_loadu_pd(data + k), g[j], sum); \
+		} \
+		_mm512_storeu_pd(y + i, sum); \
+	} \
+	for (i = 8 * blocks; i < n; i++) { \
+		y[i] = 0.0; \
+		for (j = 0; j < W; j++) { \
+			k = (offsetType)j * n + i; \
+			y[i] += data[k] * x[indices[k]]; \
+		} \
+	} \
+} \
+__attribute__((target("avx512f"))) \
+static void matvecFixed##W##RangeAVX512(const int n, const int first, const int last, const floatType* data, const int* indices, const floatType* x, floatType* y){ \
+	int i, j; \
+	offsetType k; \
+	for (i = first; i + 8 <= last; i += 8) { \
+		__m512d sum = _mm512_setzero_pd(), g[W]; \
+		FIXED_UNROLL \
+		for (j = 0; j < W; j++) \
+			g[j] = _mm512_i32gather_pd(_mm256_loadu_si256((const __m256i*)(indices + (offsetType)j * n + i)), x, 8); \
+		FIXED_UNROLL \
+		for (j = 0; j < W; j++) { \
+			k = (offsetType)j * n + i; \
+			sum = _mm512_fmadd_pd(_mm512_loadu_pd(data + k), g[j], sum); \
+		} \
+		_mm512_storeu_pd(y + i, sum); \
+	} \
+	for (; i < last; i++) { \
+		y[i] = 0.0; \
+		for (j = 0; j < W; j++) { \
+			k = (offsetType)j * n + i; \
+			y[i] += data[k] * x[indices[k]]; \
+		} \
+	} \
+}
+
+MATVEC_FIXED_AVX512(3)
+MATVEC_FIXED_AVX512(5)
+MATVEC_FIXED_AVX512(7)
+MATVEC_FIXED_AVX512(9)
+MATVEC_FIXED_AVX512(27)
+
+/* nrm <- ||x||_2 */
+__attribute__((target("avx512f")))
+static void nrm2AVX512(const floatType* x, const int n, floatType* nrm){
+	floatType temp;
+	vectorDotAVX512(x, x, n, &temp);
+	*nrm = sqrt(temp);
+}
+
+/* y <- A*x with packed column indices (see matvecPackedAVX2) */
+__attribute__((target("avx512f")))
+static void matvecPackedAVX512(const struct PackedMatrix* P, const floatType* x, floatType* y){
+	const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	const int full = P->n / PACK_ROWS;
+	int c, j;
+
+#pragma omp parallel for num_threads(threads) private(c, j)
+	for (c = 0; c < full; c++) {
+		const floatType* values = P->values + P->start[c];
+		const uint8_t* codes = P->codes + P->codeStart[c];
+		const __m256i row = _mm256_add_epi32(_mm256_set1_epi32(c * PACK_ROWS + P->base[c]), lanes);
+		__m512d sum = _mm512_setzero_pd();
+		__m256i idx;
+
+		for (j = 0; j < P->length[c]; j++) {
+			if (P->width[c] == 1)
+				idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(codes + j * PACK_ROWS)));
+			else if (P->width[c] == 2)
+				idx = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(codes + 2 * j * PACK_ROWS)));
+			else
+				idx = _mm256_loadu_si256((const __m256i*)(codes + 4 * j * PACK_ROWS));
+			idx = _mm256_add_epi32(idx, row);
+			sum = _mm512_fmadd_pd(_mm512_loadu_pd(values + j * PACK_ROWS), _mm512_i32gather_pd(idx, x, 8), sum);
+		}
+		_mm512_storeu_pd(y + c * PACK_ROWS, sum);
+	}
+	if (full < P->chunks)
+		matvecPackedChunk(P, full, x, y);
+}
+
+const struct Kernels avx512Kernels = {
+	"avx512", vectorDotAVX512, axpyAVX512, xpayAVX512, matvecAVX512, nrm2AVX512,
+	{matvecFixed3AVX512, matvecFixed5AVX512, matvecFixed7AVX512, matvecFixed9AVX512, matvecFixed27AVX512},
+	matvecPackedAVX512,
+	blockDotAVX512,
+	matvecRangeAVX512,
+	{matvecFixed3RangeAVX512, matvecFixed5RangeAVX512, matvecFixed7RangeAVX512, matvecFixed9RangeAVX512, matvecFixed27RangeAVX512}
+};
+
+#endif
@@ -0,0 +1,78 @@
+/*****************************************************
+ * CG Solver (HPC Software Lab)
+ *
+ * Parallel Programming Models for Applications in the 
+ * Area of High-Performance Computation
+ *====================================================
+ * AVX2 and AVX-512 kernels
+ *****************************************************/
+
+
+#ifndef __SIMD_H__
+#define __SIMD_H__
+
+#include "def.h"
+
+/* The hand-vectorized kernels need the x86 intrinsics and the
+ * target attribute of GCC compatible compilers. Everywhere else
+ * only the scalar kernels of solver.c are built. */
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__)) && !defined(_OPENACC) && !defined(CUDA)
+# define HAVE_SIMD_KERNELS
+#endif
+
+/* Number of row lengths with a specialized matvec kernel and
+ * these lengths, see createEllOperator() */
+#define FIXED_WIDTHS 5
+extern const int fixedWidth[FIXED_WIDTHS];
+
+/* Unroll the inner loop of the specialized kernels completely */
+#if defined(__GNUC__) && !defined(__INTEL_COMPILER) && !defined(__clang__)
+# define FIXED_UNROLL _Pragma("GCC unroll 32")
+#else
+# define FIXED_UNROLL
+#endif
+
+/* Load the cache line of p for reading */
+#if defined(__GNUC__) || defined(__clang__)
+# define PREFETCH(p) __builtin_prefetch(p, 0, 1)
+#else
+# define PREFETCH(p)
+#endif
+
+struct PackedMatrix;
+
+/* One implementation of the kernels of the CG algorithm */
+struct Kernels {
+	const char* name;
+	void (*vectorDot)(const floatType* a, const floatType* b, const int n, floatType* ab);
+	void (*axpy)(const floatType a, const floatType* x, const int n, floatType* y);
+	void (*xpay)(const floatType* x, const floatType a, const int n, floatType* y);
+	void (*matvec)(const int n, const offsetType nnz, const int maxNNZ, const floatType* data, const int* indices, const int* length, const floatType* x, floatType* y);
+	void (*nrm2)(const floatType* x, const int n, floatType* nrm);
+	/* y <- A*x for rows with at most fixedWidth[w] entries */
+	void (*matvecFixed[FIXED_WIDTHS])(const int n, const floatType* data, const int* indices, const floatType* x, floatType* y);
+	/* y <- A*x with packed column indices */
+	void (*matvecPacked)(const struct PackedMatrix* P, const floatType* x, floatType* y);
+	/* a' * b for one block of a reproducible reduction, by the
+	 * calling thread alone */
+	floatType (*blockDot)(const floatType* a, const floatType* b, const int n);
+	/* matvec and matvecFixed for the rows first ... last-1 of the
+	 * n rows only, by the calling thread alone (see stealFor()) */
+	void (*matvecRange)(const int n, const int first, const int last, const floatType* data, const int* indices, const int* length, const floatType* x, floatType* y);
+	void (*matvecFixedRange[FIXED_WIDTHS])(const int n, const int first, const int last, const floatType* data, const int* indices, const floatType* x, floatType* y);
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#ifdef HAVE_SIMD_KERNELS
+extern const struct Kernels avx2Kernels;
+extern const struct Kernels avx512Kernels;
+int cpuHasAVX2(void);
+int cpuHasAVX512(void);
+#endif
+#ifdef __cplusplus
+}
+#endif
+
+#endif
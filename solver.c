@@ -25,13 +25,22 @@
 #endif
 
 #include "solver.h"
+#include "simd.h"
+#include "bucket.h"
+#include "blocked.h"
+#include "split.h"
+#include "dict.h"
+#include "packed.h"
+#include "steal.h"
+#include "alloc.h"
+#include "io.h"
 #include "output.h"
 
 int threads = 32;
 
 
 /* ab <- a' * b */
-void vectorDot(const floatType* a, const floatType* b, const int n, floatType* ab){
+static void vectorDotScalar(const floatType* a, const floatType* b, const int n, floatType* ab){
 
 	int i;
 	floatType temp;
@@ -46,7 +55,7 @@ void vectorDot(const floatType* a, const floatType* b, const int n, floatType* a
 }
 
 /* y <- ax + y */
-void axpy(const floatType a, const floatType* x, const int n, floatType* y){
+static void axpyScalar(const floatType a, const floatType* x, const int n, floatType* y){
 	int i;
 #pragma omp parallel for num_threads(threads) private(i)
 	for(i=0; i<n; i++){
@@ -55,7 +64,7 @@ void axpy(const floatType a, const floatType* x, const int n, floatType* y){
 }
 
 /* y <- x + ay */
-void xpay(const floatType* x, const floatType a, const int n, floatType* y){
+static void xpayScalar(const floatType* x, const floatType a, const int n, floatType* y){
 	int i;
 #pragma omp parallel for num_threads(threads) private(i)
 	for(i=0; i<n; i++){
@@ -65,20 +74,52 @@ void xpay(const floatType* x, const floatType a, const int n, floatType* y){
 
 /* y <- A*x
  * Remember that A is stored in the ELLPACK-R format (data, indices, length, n, nnz, maxNNZ). */
-void matvec(const int n, const int nnz, const int maxNNZ, const floatType* data, const int* indices, const int* length, const floatType* x, floatType* y){
-	int i, j, k;
+static void matvecScalar(const int n, const offsetType nnz, const int maxNNZ, const floatType* data, const int* indices, const int* length, const floatType* x, floatType* y){
+	int i, j;
+	offsetType k;
 	#pragma omp parallel for num_threads(threads) private(i, j, k)
 	for (i = 0; i < n; i++) {
 	y[i] = 0.0;
 	for (j = 0; j < length[i]; j++) {
-		k = j * n + i;
+		k = (offsetType)j * n + i;
 	y[i] += data[k] * x[indices[k]];
 	}
 
 	}
 }
+/* y <- A*x for the rows first ... last-1 only, by the calling thread */
+static void matvecRangeScalar(const int n, const int first, const int last, const floatType* data, const int* indices, const int* length, const floatType* x, floatType* y){
+	int i, j;
+	offsetType k;
+	floatType sum;
+	for (i = first; i < last; i++) {
+		sum = 0.0;
+		for (j = 0; j < length[i]; j++) {
+			k = (offsetType)j * n + i;
+			sum += data[k] * x[indices[k]];
+		}
+		y[i] = sum;
+	}
+}
+
+/* y <- A*x for the count rows listed in rows only.
+ * n is the number of rows of the ELLPACK-R matrix. */
+void matvecRows(const int n, const int* rows, const int count, const floatType* data, const int* indices, const int* length, const floatType* x, floatType* y){
+	int i, j, r;
+	offsetType k;
+	#pragma omp parallel for num_threads(threads) private(i, j, k, r)
+	for (r = 0; r < count; r++) {
+		i = rows[r];
+		y[i] = 0.0;
+		for (j = 0; j < length[i]; j++) {
+			k = (offsetType)j * n + i;
+			y[i] += data[k] * x[indices[k]];
+		}
+	}
+}
+
 /* nrm <- ||x||_2 */
-void nrm2(const floatType* x, const int n, floatType* nrm){
+static void nrm2Scalar(const floatType* x, const int n, floatType* nrm){
 	int i;
 	floatType temp;
 	temp = 0;
@@ -89,17 +130,572 @@ void nrm2(const floatType* x, const int n, floatType* nrm){
 	*nrm=sqrt(temp);
 }
 
+/* a' * b for one block, with four sums for pipelined additions */
+static floatType blockDotScalar(const floatType* a, const floatType* b, const int n){
+	floatType s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+	int i;
+
+	for (i = 0; i + 4 <= n; i += 4) {
+		s0 += a[i] * b[i];
+		s1 += a[i + 1] * b[i + 1];
+		s2 += a[i + 2] * b[i + 2];
+		s3 += a[i + 3] * b[i + 3];
+	}
+	for (; i < n; i++)
+		s0 += a[i] * b[i];
+	return (s0 + s1) + (s2 + s3);
+}
+
+/* Row lengths with a specialized matvec kernel */
+const int fixedWidth[FIXED_WIDTHS] = {3, 5, 7, 9, 27};
+
+/* y <- A*x for rows with at most W entries, for all rows or the
+ * rows first ... last-1. The loop over the entries of a row has a
+ * constant trip count and is unrolled completely, length is not
+ * read at all. Shorter rows multiply their zero padding. */
+#define MATVEC_FIXED(W) \
+static void matvecFixed##W##Scalar(const int n, const floatType* data, const int* indices, const floatType* x, floatType* y){ \
+	int i, j; \
+	offsetType k; \
+	floatType sum; \
+	_Pragma("omp parallel for num_threads(threads) private(i, j, k, sum)") \
+	for (i = 0; i < n; i++) { \
+		sum = 0.0; \
+		FIXED_UNROLL \
+		for (j = 0; j < W; j++) { \
+			k = (offsetType)j * n + i; \
+			sum += data[k] * x[indices[k]]; \
+		} \
+		y[i] = sum; \
+	} \
+} \
+static void matvecFixed##W##RangeScalar(const int n, const int first, const int last, const floatType* data, const int* indices, const floatType* x, floatType* y){ \
+	int i, j; \
+	offsetType k; \
+	floatType sum; \
+	for (i = first; i < last; i++) { \
+		sum = 0.0; \
+		FIXED_UNROLL \
+		for (j = 0; j < W; j++) { \
+			k = (offsetType)j * n + i; \
+			sum += data[k] * x[indices[k]]; \
+		} \
+		y[i] = sum; \
+	} \
+}
+
+MATVEC_FIXED(3)
+MATVEC_FIXED(5)
+MATVEC_FIXED(7)
+MATVEC_FIXED(9)
+MATVEC_FIXED(27)
+
+static const struct Kernels scalarKernels = {
+	"scalar", vectorDotScalar, axpyScalar, xpayScalar, matvecScalar, nrm2Scalar,
+	{matvecFixed3Scalar, matvecFixed5Scalar, matvecFixed7Scalar, matvecFixed9Scalar, matvecFixed27Scalar},
+	matvecPackedScalar,
+	blockDotScalar,
+	matvecRangeScalar,
+	{matvecFixed3RangeScalar, matvecFixed5RangeScalar, matvecFixed7RangeScalar, matvecFixed9RangeScalar, matvecFixed27RangeScalar}
+};
+
+/* Kernels used by the CG algorithm, see selectKernels() */
+static const struct Kernels* kernels = &scalarKernels;
+
+/* Choose the kernels requested by CG_KERNEL. "auto" takes the
+ * widest vector instructions the processor supports, so the same
+ * binary runs on all nodes. A variant the processor cannot execute
+ * is replaced by the next narrower one. */
+void selectKernels(void){
+	kernels = &scalarKernels;
+#ifdef HAVE_SIMD_KERNELS
+	if (config.kernel == KERNEL_SCALAR)
+		return;
+	if ((config.kernel == KERNEL_AUTO || config.kernel == KERNEL_AVX512) && cpuHasAVX512()) {
+		kernels = &avx512Kernels;
+		return;
+	}
+	if (config.kernel == KERNEL_AVX512)
+		printf("WARNING: This processor does not support AVX-512!\n");
+	if (cpuHasAVX2())
+		kernels = &avx2Kernels;
+	else if (config.kernel != KERNEL_AUTO)
+		printf("WARNING: This processor does not support AVX2, using the scalar kernels!\n");
+#else
+	if (config.kernel != KERNEL_AUTO && config.kernel != KERNEL_SCALAR)
+		printf("WARNING: This binary has no vectorized kernels, using the scalar kernels!\n");
+#endif
+}
+
+/* Name of the selected kernel variant */
+const char* kernelName(void){
+	return kernels->name;
+}
+
+/* Entries per block of the reproducible reductions */
+#define REDUCE_BLOCK 1024
+
+/* Number of blocks of the reproducible reductions for n entries */
+#define REDUCE_BLOCKS(n) (((n) + REDUCE_BLOCK - 1) / REDUCE_BLOCK)
+
+/* a' * b for one block with compensated (Kahan) summation */
+static floatType blockDotCompensated(const floatType* a, const floatType* b, const int n){
+	floatType sum = 0.0, c = 0.0, y, t;
+	int i;
+
+	for (i = 0; i < n; i++) {
+		y = a[i] * b[i] - c;
+		t = sum + y;
+		c = (t - sum) - y;
+		sum = t;
+	}
+	return sum;
+}
+
+/* ab <- a' * b, bitwise the same for every number of threads. The
+ * vectors are cut into blocks of REDUCE_BLOCK entries independent of
+ * the threads, every block is summed up by one thread, and the sums
+ * of the blocks are added pairwise in a fixed tree. The sums live
+ * in the workspace of the solver, so solvers in several threads of
+ * the application do not share them. */
+static void vectorDotReproducible(const floatType* a, const floatType* b, const int n, floatType* ab, floatType* sums){
+	const int blocks = REDUCE_BLOCKS(n);
+	int i, width;
+
+#pragma omp parallel for num_threads(threads) private(i)
+	for (i = 0; i < blocks; i++) {
+		const int first = i * REDUCE_BLOCK;
+		const int count = (i < blocks - 1) ? REDUCE_BLOCK : n - first;
+		if (config.reproducible > 1)
+			sums[i] = blockDotCompensated(a + first, b + first, count);
+		else
+			sums[i] = kernels->blockDot(a + first, b + first, count);
+	}
+
+	for (width = 1; width < blocks; width *= 2)
+		for (i = 0; i + width < blocks; i += 2 * width)
+			sums[i] += sums[i + width];
+	*ab = (blocks > 0) ? sums[0] : 0.0;
+}
+
+void vectorDot(const floatType* a, const floatType* b, const int n, floatType* ab, struct Workspace* ws){
+	if (config.reproducible) {
+		vectorDotReproducible(a, b, n, ab, ws->sums);
+		return;
+	}
+	kernels->vectorDot(a, b, n, ab);
+}
+
+void axpy(const floatType a, const floatType* x, const int n, floatType* y){
+	kernels->axpy(a, x, n, y);
+}
+
+void xpay(const floatType* x, const floatType a, const int n, floatType* y){
+	kernels->xpay(x, a, n, y);
+}
+
+void matvec(const int n, const offsetType nnz, const int maxNNZ, const floatType* data, const int* indices, const int* length, const floatType* x, floatType* y){
+	kernels->matvec(n, nnz, maxNNZ, data, indices, length, x, y);
+}
+
+void nrm2(const floatType* x, const int n, floatType* nrm, struct Workspace* ws){
+	floatType temp;
+
+	if (config.reproducible) {
+		vectorDotReproducible(x, x, n, &temp, ws->sums);
+		*nrm = sqrt(temp);
+		return;
+	}
+	kernels->nrm2(x, n, nrm);
+}
+
+void matvecPacked(const struct PackedMatrix* P, const floatType* x, floatType* y){
+	kernels->matvecPacked(P, x, y);
+}
+ 
+
+/* Arrays of an operator in ELLPACK-R format. If the rows have
+ * almost all the same length, they are multiplied by the kernel
+ * for the fixed row length fixedWidth[fixed], and the entries
+ * beyond that width of the few longer rows listed in outliers
+ * are added afterwards. fixed is -1 for the generic kernel.
+ * If prefetch is not 0, matvecPrefetch() is used instead. With a
+ * work-stealing schedule steal the same kernels run on the chunks
+ * of rows. */
+struct EllState {
+	int maxNNZ;
+	const floatType* data;
+	const int* indices;
+	const int* length;
+	int fixed;
+	int* outliers;
+	int outlierCount;
+	int prefetch;
+	struct StealSchedule* steal;
+};
+
+/* Find the specialized row length for which the fixed kernel plus
+ * the outlier rows do the least work. An entry of an outlier row
+ * costs FIXED_OUTLIER_COST entries of the fixed kernel, as these
+ * rows are scattered over the matrix. Return -1 if the best choice
+ * does more than FIXED_OVERHEAD times the work of the generic kernel. */
+#define FIXED_OVERHEAD 1.1
+#define FIXED_OUTLIER_COST 4
+static int fixedKernel(const int n, const offsetType nnz, const int maxNNZ, const int* length){
+	offsetType* histogram;
+	double work, bestWork;
+	int i, w, best;
+
+	/* Row length histogram */
+	histogram = (offsetType*)calloc(maxNNZ + 1, sizeof(offsetType));
+	if (histogram == NULL) {
+		puts("Out of memory!");
+		fatalError();
+	}
+	for (i = 0; i < n; i++)
+		histogram[length[i]]++;
+
+	best = -1;
+	bestWork = FIXED_OVERHEAD * nnz;
+	for (w = 0; w < FIXED_WIDTHS; w++) {
+		if (fixedWidth[w] > maxNNZ)
+			break;
+		work = (double)n * fixedWidth[w];
+		for (i = fixedWidth[w] + 1; i <= maxNNZ; i++)
+			work += (double)histogram[i] * (i - fixedWidth[w]) * FIXED_OUTLIER_COST;
+		if (work <= bestWork) {
+			best = w;
+			bestWork = work;
+		}
+	}
+
+	free(histogram);
+	return best;
+}
+
+/* y <- A*x like matvec() for the rows first ... last-1, but while
+ * row i is multiplied the x entries of row i+dist are prefetched.
+ * They are found in the indices stream dist positions ahead of the
+ * current entry. */
+static void matvecPrefetchRange(const int n, const int first, const int last, const floatType* data, const int* indices, const int* length, const floatType* x, floatType* y, const int dist){
+	int i, j;
+	offsetType k;
+	floatType sum;
+	for (i = first; i < last; i++) {
+		sum = 0.0;
+		if (i + dist < n) {
+			for (j = 0; j < length[i]; j++) {
+				k = (offsetType)j * n + i;
+				PREFETCH(&x[indices[k + dist]]);
+				sum += data[k] * x[indices[k]];
+			}
+		} else {
+			for (j = 0; j < length[i]; j++) {
+				k = (offsetType)j * n + i;
+				sum += data[k] * x[indices[k]];
+			}
+		}
+		y[i] = sum;
+	}
+}
+
+/* y <- A*x with prefetching for all rows in one block per thread */
+static void matvecPrefetch(const int n, const floatType* data, const int* indices, const int* length, const floatType* x, floatType* y, const int dist){
+	int t;
+#pragma omp parallel for num_threads(threads) private(t)
+	for (t = 0; t < threads; t++)
+		matvecPrefetchRange(n, (int)((long long)n * t / threads), (int)((long long)n * (t + 1) / threads), data, indices, length, x, y, dist);
+}
+
+/* Arguments of matvecChunk() */
+struct MatvecChunk {
+	const struct EllState* s;
+	int n;
+	const floatType* x;
+	floatType* y;
+};
+
+/* y <- A*x for the rows first ... last-1, a chunk of stealFor(),
+ * with the kernel applyEll() uses for all rows */
+static void matvecChunk(void* arg, const int first, const int last){
+	const struct MatvecChunk* a = (const struct MatvecChunk*)arg;
+	const struct EllState* s = a->s;
+	const int n = a->n;
+	int i, j, r, lo, hi;
+	offsetType k;
+
+	if (s->prefetch > 0) {
+		matvecPrefetchRange(n, first, last, s->data, s->indices, s->length, a->x, a->y, s->prefetch);
+		return;
+	}
+	if (s->fixed < 0) {
+		kernels->matvecRange(n, first, last, s->data, s->indices, s->length, a->x, a->y);
+		return;
+	}
+	kernels->matvecFixedRange[s->fixed](n, first, last, s->data, s->indices, a->x, a->y);
+
+	/* The outliers are sorted, find the first one of the chunk */
+	lo = 0;
+	hi = s->outlierCount;
+	while (lo < hi) {
+		r = (lo + hi) / 2;
+		if (s->outliers[r] < first)
+			lo = r + 1;
+		else
+			hi = r;
+	}
+	for (r = lo; r < s->outlierCount && s->outliers[r] < last; r++) {
+		i = s->outliers[r];
+		for (j = fixedWidth[s->fixed]; j < s->length[i]; j++) {
+			k = (offsetType)j * n + i;
+			a->y[i] += s->data[k] * a->x[s->indices[k]];
+		}
+	}
+}
+
+/* y <- A*x in ELLPACK-R format */
+static void applyEll(const struct Operator* A, const floatType* x, floatType* y){
+	const struct EllState* s = (const struct EllState*)A->state;
+	const int n = A->n, width = s->fixed < 0 ? 0 : fixedWidth[s->fixed];
+	int i, j, r;
+	offsetType k;
+
+	if (s->steal != NULL) {
+		struct MatvecChunk arg = {s, n, x, y};
+		stealFor(s->steal, matvecChunk, &arg);
+		return;
+	}
+
+	if (s->prefetch > 0) {
+		matvecPrefetch(n, s->data, s->indices, s->length, x, y, s->prefetch);
+		return;
+	}
+
+	if (s->fixed < 0) {
+		matvec(n, A->nnz, s->maxNNZ, s->data, s->indices, s->length, x, y);
+		return;
+	}
+
+	kernels->matvecFixed[s->fixed](n, s->data, s->indices, x, y);
+	if (s->outlierCount == 0)
+		return;
+#pragma omp parallel for num_threads(threads) private(i, j, k, r)
+	for (r = 0; r < s->outlierCount; r++) {
+		i = s->outliers[r];
+		for (j = width; j < s->length[i]; j++) {
+			k = (offsetType)j * n + i;
+			y[i] += s->data[k] * x[s->indices[k]];
+		}
+	}
+}
+
+static void destroyEll(struct Operator* A){
+	struct EllState* s = (struct EllState*)A->state;
+	free(s->outliers);
+	if (s->steal != NULL)
+		destroyStealSchedule(s->steal);
+	free(s);
+}
+
+/* Find the prefetch distance (in rows) with the fastest matvec.
+ * Every candidate, including no prefetching at all, is timed for
+ * PREFETCH_RUNS products and the best run counts. */
+#define PREFETCH_RUNS 3
+static const int prefetchDistance[] = {0, 8, 16, 32, 64, 128, 256};
+
+static int tunePrefetch(struct Operator* A){
+	struct EllState* s = (struct EllState*)A->state;
+	floatType *x, *y;
+	double t, best, bestTime = 0.0;
+	int c, run, i, dist = 0;
+
+	x = (floatType*)allocLarge(sizeof(floatType) * A->n);
+	y = (floatType*)allocLarge(sizeof(floatType) * A->n);
+#pragma omp parallel for num_threads(threads) private(i)
+	for (i = 0; i < A->n; i++)
+		x[i] = 1.0;
+
+	for (c = 0; c < (int)(sizeof(prefetchDistance) / sizeof(prefetchDistance[0])); c++) {
+		s->prefetch = prefetchDistance[c];
+		best = 0.0;
+		for (run = 0; run < PREFETCH_RUNS; run++) {
+			t = getWTime();
+			A->apply(A, x, y);
+			t = getWTime() - t;
+			if (run == 0 || t < best)
+				best = t;
+		}
+		if (c == 0 || best < bestTime) {
+			bestTime = best;
+			dist = prefetchDistance[c];
+		}
+	}
+
+	freeLarge(x);
+	freeLarge(y);
+	return dist;
+}
+
+/* Create an operator for the matrix in ELLPACK-R format. The arrays
+ * are not copied and must stay valid while the operator is used. */
+struct Operator* createEllOperator(const int n, const offsetType nnz, const int maxNNZ, const floatType* data, const int* indices, const int* length){
+	struct Operator* A;
+	struct EllState* s;
+	int i;
+
+	DBGMAT("Start matrix A = ", n, nnz, maxNNZ, data, indices, length)
+
+	A = (struct Operator*)malloc(sizeof(struct Operator));
+	s = (struct EllState*)malloc(sizeof(struct EllState));
+	if (A == NULL || s == NULL) {
+		puts("Out of memory!");
+		fatalError();
+	}
+
+	s->maxNNZ = maxNNZ;
+	s->data = data;
+	s->indices = indices;
+	s->length = length;
+	s->steal = (config.schedule == SCHEDULE_STEAL) ? createStealSchedule(n, NULL, length) : NULL;
+	s->fixed = config.specialize ? fixedKernel(n, nnz, maxNNZ, length) : -1;
+	s->outliers = NULL;
+	s->outlierCount = 0;
+
+	if (s->fixed >= 0) {
+		for (i = 0; i < n; i++)
+			if (length[i] > fixedWidth[s->fixed])
+				s->outlierCount++;
+		s->outliers = (int*)malloc(sizeof(int) * (s->outlierCount + 1));
+		if (s->outliers == NULL) {
+			puts("Out of memory!");
+			fatalError();
+		}
+		s->outlierCount = 0;
+		for (i = 0; i < n; i++)
+			if (length[i] > fixedWidth[s->fixed])
+				s->outliers[s->outlierCount++] = i;
+	}
+
+	A->n = n;
+	A->nnz = nnz;
+	A->diag = NULL;
+	A->apply = applyEll;
+	A->destroy = destroyEll;
+	A->state = s;
+
+	/* Prefetch with the configured distance, or the fastest one */
+	s->prefetch = config.prefetch < 0 ? tunePrefetch(A) : config.prefetch;
+
+	if (s->prefetch > 0)
+		snprintf(A->format, sizeof(A->format), "ELLPACK-R, prefetch %d", s->prefetch);
+	else if (s->fixed >= 0)
+		snprintf(A->format, sizeof(A->format), "ELLPACK-R, width %d", fixedWidth[s->fixed]);
+	else
+		snprintf(A->format, sizeof(A->format), "ELLPACK-R");
+	if (s->steal != NULL)
+		strncat(A->format, ", work stealing", sizeof(A->format) - strlen(A->format) - 1);
+
+	return A;
+}
+
+/* Create an operator for the matrix in the storage format chosen
+ * by CG_FORMAT. The ELLPACK-R arrays must stay valid while the
+ * operator is used, other formats copy what they need. */
+struct Operator* createOperator(const int n, const offsetType nnz, const int maxNNZ, const floatType* data, const int* indices, const int* length){
+	struct Operator* A;
+
+	switch (config.format) {
+	case FORMAT_BUCKET:
+		return createBucketOperator(n, nnz, maxNNZ, data, indices, length);
+	case FORMAT_BLOCKED:
+		return createBlockedOperator(n, nnz, maxNNZ, data, indices, length);
+	case FORMAT_SPLIT:
+		return createSplitOperator(n, nnz, maxNNZ, data, indices, length);
+	case FORMAT_PACKED:
+		return createPackedOperator(n, nnz, maxNNZ, data, indices, length);
+	case FORMAT_DICT:
+		if ((A = createDictOperator(n, nnz, maxNNZ, data, indices, length)) != NULL)
+			return A;
+		printf("WARNING: Too many distinct values for codes, using ELLPACK-R!\n");
+		return createEllOperator(n, nnz, maxNNZ, data, indices, length);
+	default:
+		return createEllOperator(n, nnz, maxNNZ, data, indices, length);
+	}
+}
+
+/* Free an operator of any format */
+void destroyOperator(struct Operator* A){
+	A->destroy(A);
+	free(A);
+}
+
+
+/* Allocate the scratch vectors for systems of dimension n */
+struct Workspace* createWorkspace(const int n){
+	struct Workspace* ws;
+	size_t perLine = ALIGNMENT / sizeof(floatType);
+	int i, v;
+
+	ws = (struct Workspace*)malloc(sizeof(struct Workspace));
+	if (ws == NULL) {
+		puts("Out of memory!");
+		fatalError();
+	}
+
+	/* Round every vector up to full cache lines */
+	ws->n = n;
+	ws->stride = (n + perLine - 1) / perLine * perLine;
+	ws->base = (floatType*)allocLarge(WORKSPACE_VECTORS * ws->stride * sizeof(floatType));
+
+	/* Touch the pages with the same static partition as the
+	 * kernels, so they are placed on the NUMA node of the
+	 * thread which uses them and no page faults occur later. */
+	for (v = 0; v < WORKSPACE_VECTORS; v++) {
+		floatType* vec = ws->base + v * ws->stride;
+#pragma omp parallel for num_threads(threads) private(i)
+		for (i = 0; i < n; i++) {
+			vec[i] = 0.0;
+		}
+	}
+
+	ws->r = ws->base;
+	ws->p = ws->base + ws->stride;
+	ws->q = ws->base + 2 * ws->stride;
+	ws->z = ws->base + 3 * ws->stride;
+	ws->deflation = NULL;
+
+	ws->sums = (floatType*)malloc(sizeof(floatType) * (REDUCE_BLOCKS(n) + 1));
+	if (ws->sums == NULL) {
+		puts("Out of memory!");
+		fatalError();
+	}
+
+	return ws;
+}
+
+/* Free the scratch vectors and the workspace itself */
+void destroyWorkspace(struct Workspace* ws){
+	if (ws->deflation != NULL)
+		destroyDeflation(ws->deflation);
+	freeLarge(ws->base);
+	free(ws->sums);
+	free(ws);
+}
+
 
 /***************************************
  *         Conjugate Gradient          *
  *   This function will do the CG      *
- *  algorithm without preconditioning. *
+ *  algorithm with the preconditioner  *
+ *  M, or without for M = NULL, where  *
+ *  z(k) is r(k) itself.               *
  *    For optimiziation you must not   *
  *        change the algorithm.        *
  ***************************************
  r(0)    = b - Ax(0)
- p(0)    = r(0)
- rho(0)    =  <r(0),r(0)>                
+ z(0)    = M^-1 r(0)
+ p(0)    = z(0)
+ rho(0)    =  <r(0),z(0)>
  ***************************************
  for k=0,1,2,...,n-1
    q(k)      = A * p(k)                 
@@ -108,62 +704,113 @@ void nrm2(const floatType* x, const int n, floatType* nrm){
    x(k+1)    = x(k) + alpha*p(k)      
    r(k+1)    = r(k) - alpha*q(k)     
    check convergence ||r(k+1)||_2 < eps  
-	 rho(k+1)  = <r(k+1), r(k+1)>         
+   z(k+1)    = M^-1 r(k+1)
+   rho(k+1)  = <r(k+1), z(k+1)>
    beta      = rho(k+1) / rho(k)
-   p(k+1)    = r(k+1) + beta*p(k)      
+   p(k+1)    = z(k+1) + beta*p(k)
+ ***************************************
+ With a deflation space W in the
+ workspace (Saad, Yeung, Erhel and
+ Guyomarc'h, 2000), x(0) is moved so
+ that W^T r(0) = 0 and every p loses
+ W (W^T A W)^-1 (AW)^T z(k).
 ***************************************/
-void cg(const int n, const int nnz, const int maxNNZ, const floatType* data, const int* indices, const int* length, const floatType* b, floatType* x, struct SolverConfig* sc){
-	floatType* r, *p, *q;
-	floatType alpha, beta, rho, rho_old, dot_pq, bnrm2;
-	int iter;
+void cg(const struct Operator* A, const struct Preconditioner* M, const floatType* b, floatType* x, struct SolverConfig* sc, struct Workspace* ws){
+	const int n = A->n;
+	floatType* r = ws->r, *p = ws->p, *q = ws->q;
+	floatType* z = (M != NULL) ? ws->z : ws->r;
+	struct Deflation* D = (sc->restartFile == NULL) ? ws->deflation : NULL;
+	floatType alpha, beta, rho, rho_old, dot_pq, dot_rr, bnrm2;
+	int iter, first;
  	double timeMatvec_s;
  	double timeMatvec=0;
-	
-	/* allocate memory */
-	r = (floatType*)malloc(n * sizeof(floatType));
-	p = (floatType*)malloc(n * sizeof(floatType));
-	q = (floatType*)malloc(n * sizeof(floatType));
-	
-	DBGMAT("Start matrix A = ", n, nnz, maxNNZ, data, indices, length)
+	double timePrecond_s;
+	double timePrecond=0;
+
 	DBGVEC("b = ", b, n);
 	DBGVEC("x = ", x, n);
 
-	/* r(0)    = b - Ax(0) */
-	timeMatvec_s = getWTime();
-	matvec(n, nnz, maxNNZ, data, indices, length, x, r);
-	timeMatvec += getWTime() - timeMatvec_s;
-	xpay(b, -1.0, n, r);
-	DBGVEC("r = b - Ax = ", r, n);
-	
-
-	/* Calculate initial residuum */
-	nrm2(r, n, &bnrm2);
-	bnrm2 = 1.0 /bnrm2;
-
-	/* p(0)    = r(0) */
-	memcpy(p, r, n*sizeof(floatType));
-	DBGVEC("p = r = ", p, n);
+	if (sc->restartFile != NULL) {
+		/* Continue exactly where the checkpoint was written */
+		readCheckpoint(sc->restartFile, n, x, r, p, &rho, &bnrm2, &first);
+		if (sc->verbose)
+			printf("Restart from iteration %d\n", first);
+	} else {
+		/* r(0)    = b - Ax(0) */
+		timeMatvec_s = getWTime();
+		A->apply(A, x, r);
+		timeMatvec += getWTime() - timeMatvec_s;
+		xpay(b, -1.0, n, r);
+		DBGVEC("r = b - Ax = ", r, n);
+
+		/* Normalize all residuals with ||b||_2, which is the
+		 * initial residuum for x(0) = 0. With a warm start the
+		 * initial residuum is smaller and must not tighten
+		 * the tolerance. */
+		nrm2(b, n, &bnrm2, ws);
+		bnrm2 = 1.0 /bnrm2;
+
+		/* Start with a residual orthogonal to the deflation space */
+		if (D != NULL) {
+			deflateStart(D, x, r);
+			DBGVEC("r = r - AW * mu = ", r, n);
+		}
+
+		/* z(0)    = M^-1 r(0) */
+		if (M != NULL) {
+			timePrecond_s = getWTime();
+			M->apply(M, r, z);
+			timePrecond += getWTime() - timePrecond_s;
+			DBGVEC("z = M^-1 r = ", z, n);
+		}
+
+		/* p(0)    = z(0) */
+		memcpy(p, z, n*sizeof(floatType));
+		DBGVEC("p = z = ", p, n);
+
+		/* rho(0)    =  <r(0),z(0)> */
+		vectorDot(r, z, n, &rho, ws);
+		if (D != NULL) {
+			deflateDirection(D, z, p);
+			deflateRecord(D, 0, z, rho);
+		}
+		if (sc->verbose)
+			printf("rho_0=%e\n", rho);
+
+		first = 0;
+	}
 
-	/* rho(0)    =  <r(0),r(0)> */
-	vectorDot(r, r, n, &rho);
-	printf("rho_0=%e\n", rho);
+	/* A warm start may already be good enough. Without a
+	 * preconditioner rho is <r,r>. */
+	if (M != NULL)
+		vectorDot(r, r, n, &dot_rr, ws);
+	else
+		dot_rr = rho;
+	sc->residual = sqrt(dot_rr) * bnrm2;
 
-	for(iter = 0; iter < sc->maxIter; iter++){
+	for(iter = first; iter < sc->maxIter && sc->residual > sc->tolerance; iter++){
 		DBGMSG("=============== Iteration %d ======================\n", iter);
 	
 		/* q(k)      = A * p(k) */
 		timeMatvec_s = getWTime();
-		matvec(n, nnz, maxNNZ, data, indices, length, p, q);
+		A->apply(A, p, q);
 		timeMatvec += getWTime() - timeMatvec_s;
 		DBGVEC("q = A * p= ", q, n);
 
 		/* dot_pq    = <p(k),q(k)> */
-		vectorDot(p, q, n, &dot_pq);
+		vectorDot(p, q, n, &dot_pq, ws);
 		DBGSCA("dot_pq = <p, q> = ", dot_pq);
 
 		/* alpha     = rho(k) / dot_pq */
 		alpha = rho / dot_pq;
 		DBGSCA("alpha = rho / dot_pq = ", alpha);
+		/* Keep the coefficients for the Lanczos matrix of A */
+		if (sc->alphas != NULL)
+			sc->alphas[iter - first] = alpha;
+		if (D != NULL && iter - first < D->m) {
+			D->alphas[iter - first] = alpha;
+			D->steps = iter - first + 1;
+		}
 
 		/* x(k+1)    = x(k) + alpha*p(k) */
 		axpy(alpha, p, n, x);
@@ -178,12 +825,12 @@ void cg(const int n, const int nnz, const int maxNNZ, const floatType* data, con
 		DBGSCA("rho_old = rho = ", rho_old);
 
 
-		/* rho(k+1)  = <r(k+1), r(k+1)> */
-		vectorDot(r, r, n, &rho);
-		DBGSCA("rho = <r, r> = ", rho);
+		/* ||r(k+1)||_2^2 = <r(k+1), r(k+1)> */
+		vectorDot(r, r, n, &dot_rr, ws);
+		DBGSCA("dot_rr = <r, r> = ", dot_rr);
 
 		/* Normalize the residual with initial one */
-		sc->residual= sqrt(rho) * bnrm2;
+		sc->residual= sqrt(dot_rr) * bnrm2;
 
 
    	
@@ -193,18 +840,45 @@ void cg(const int n, const int nnz, const int maxNNZ, const floatType* data, con
 		 * environment variable our solution vector
 		 * is good enough and we can stop the 
 		 * algorithm. */
-		printf("res_%d=%e\n", iter+1, sc->residual);
+		if (sc->verbose)
+			printf("res_%d=%e\n", iter+1, sc->residual);
 		if(sc->residual <= sc->tolerance)
 			break;
 
 
+		/* z(k+1)    = M^-1 r(k+1)
+		 * rho(k+1)  = <r(k+1), z(k+1)> */
+		if (M != NULL) {
+			timePrecond_s = getWTime();
+			M->apply(M, r, z);
+			timePrecond += getWTime() - timePrecond_s;
+			DBGVEC("z = M^-1 r = ", z, n);
+			vectorDot(r, z, n, &rho, ws);
+		} else {
+			rho = dot_rr;
+		}
+		DBGSCA("rho = <r, z> = ", rho);
+
 		/* beta      = rho(k+1) / rho(k) */
 		beta = rho / rho_old;
 		DBGSCA("beta = rho / rho_old= ", beta);
-
-		/* p(k+1)    = r(k+1) + beta*p(k) */
-		xpay(r, beta, n, p);
-		DBGVEC("p = r + beta * p> = ", p, n);
+		if (sc->betas != NULL)
+			sc->betas[iter - first] = beta;
+		if (D != NULL && iter - first < D->m)
+			D->betas[iter - first] = beta;
+
+		/* p(k+1)    = z(k+1) + beta*p(k), without the components
+		 * in the deflation space */
+		xpay(z, beta, n, p);
+		if (D != NULL) {
+			deflateDirection(D, z, p);
+			deflateRecord(D, iter - first + 1, z, rho);
+		}
+		DBGVEC("p = z + beta * p> = ", p, n);
+
+		/* Save the state after every checkpointInterval iterations */
+		if (sc->checkpointFile != NULL && (iter + 1) % sc->checkpointInterval == 0)
+			writeCheckpoint(sc->checkpointFile, n, x, r, p, rho, bnrm2, iter + 1);
 
 	}
 
@@ -214,9 +888,9 @@ void cg(const int n, const int nnz, const int maxNNZ, const floatType* data, con
 	 * function in the whole CG algorithm. */
 	sc->iter = iter;
 	sc->timeMatvec = timeMatvec;
+	sc->timePrecond = timePrecond;
 
-	/* Clean up */
-	free(r);
-	free(p);
-	free(q);
+	/* Refine the deflation space for the next call */
+	if (D != NULL)
+		deflateUpdate(D, A);
 }
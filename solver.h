@@ -14,17 +14,79 @@
 #ifndef __SOLVER_H__
 #define __SOLVER_H__
 
+#include <stddef.h>
+
 #include "def.h"
+#include "deflation.h"
+
+/* Number of threads used in all parallel kernels */
+extern int threads;
+
+/* Number of scratch vectors in a workspace */
+#define WORKSPACE_VECTORS 4
+
+/* Scratch vectors of the CG algorithm. They are allocated once
+ * by createWorkspace() and reused by every call of cg(). All
+ * vectors live in one aligned block, each starting on a cache
+ * line, which is touched first by the threads that later work
+ * on the same rows in the kernels. sums holds the block sums of
+ * the reproducible reductions. deflation, if set, carries the
+ * deflation space from one call of cg() to the next. */
+struct Workspace {
+	int n;
+	size_t stride;
+	floatType* base;
+	floatType *r, *p, *q, *z;
+	floatType* sums;
+	struct Deflation* deflation;
+};
+
+/* The matrix of the linear system as cg() sees it. apply computes
+ * y <- A*x with the arrays of the storage format in state, which
+ * destroy frees again. format describes the storage format. Formats
+ * which keep the diagonal of the matrix in an array of its own
+ * provide it in diag for the preconditioners, the others set NULL. */
+struct Operator {
+	int n;
+	offsetType nnz;
+	char format[64];
+	const floatType* diag;
+	void (*apply)(const struct Operator* A, const floatType* x, floatType* y);
+	void (*destroy)(struct Operator* A);
+	void* state;
+};
+
+/* A preconditioner M of cg(). apply computes z <- M^-1 * r with
+ * the data in state, which destroy frees again. name describes it
+ * for the output. */
+struct Preconditioner {
+	int n;
+	char name[64];
+	void (*apply)(const struct Preconditioner* M, const floatType* r, floatType* z);
+	void (*destroy)(struct Preconditioner* M);
+	void* state;
+};
+
+struct PackedMatrix;
 
 #ifdef __cplusplus
 	extern "C" {
 #endif
-	void vectorDot(const floatType* a, const floatType* b, const int n, floatType* ab);
+	void vectorDot(const floatType* a, const floatType* b, const int n, floatType* ab, struct Workspace* ws);
 	void axpy(const floatType a, const floatType* x, const int n, floatType* y);
 	void xpay(const floatType* x, const floatType a, const int n, floatType* y);
-	void matvec(const int n, const int nnz, const int maxNNZ, const floatType* data, const int* indices, const int* length, const floatType* x, floatType* y);
-	void nrm2(const floatType* x, const int n, floatType* nrm);
-	void cg(const int n, const int nnz, const int maxNNZ, const floatType* data, const int* indices, const int* length, const floatType* b, floatType* x, struct SolverConfig* sc);
+	void matvec(const int n, const offsetType nnz, const int maxNNZ, const floatType* data, const int* indices, const int* length, const floatType* x, floatType* y);
+	void matvecRows(const int n, const int* rows, const int count, const floatType* data, const int* indices, const int* length, const floatType* x, floatType* y);
+	void nrm2(const floatType* x, const int n, floatType* nrm, struct Workspace* ws);
+	void matvecPacked(const struct PackedMatrix* P, const floatType* x, floatType* y);
+	void selectKernels(void);
+	const char* kernelName(void);
+	struct Operator* createEllOperator(const int n, const offsetType nnz, const int maxNNZ, const floatType* data, const int* indices, const int* length);
+	struct Operator* createOperator(const int n, const offsetType nnz, const int maxNNZ, const floatType* data, const int* indices, const int* length);
+	void destroyOperator(struct Operator* A);
+	struct Workspace* createWorkspace(const int n);
+	void destroyWorkspace(struct Workspace* ws);
+	void cg(const struct Operator* A, const struct Preconditioner* M, const floatType* b, floatType* x, struct SolverConfig* sc, struct Workspace* ws);
 #ifdef __cplusplus
 	}
 #endif
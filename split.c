@@ -0,0 +1,123 @@
+/*****************************************************
+ * CG Solver (HPC Software Lab)
+ *
+ * Parallel Programming Models for Applications in the 
+ * Area of High-Performance Computation
+ *====================================================
+ * Operator with a separate dense diagonal
+ *****************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "split.h"
+#include "alloc.h"
+#include "io.h"
+
+/* The matrix split into its diagonal diag and the off-diagonal
+ * entries, which are stored in ELLPACK-R format with maxNNZ
+ * columns. */
+struct SplitState {
+	int maxNNZ;
+	floatType* diag;
+	floatType* data;
+	int* indices;
+	int* length;
+};
+
+/* y <- A*x = D*x + (A-D)*x. The diagonal is a streaming multiply
+ * without index and gather. */
+static void applySplit(const struct Operator* A, const floatType* x, floatType* y){
+	const struct SplitState* s = (const struct SplitState*)A->state;
+	const int n = A->n;
+	int i, j;
+	offsetType k;
+	floatType sum;
+
+#pragma omp parallel for num_threads(threads) private(i, j, k, sum)
+	for (i = 0; i < n; i++) {
+		sum = s->diag[i] * x[i];
+		for (j = 0; j < s->length[i]; j++) {
+			k = (offsetType)j * n + i;
+			sum += s->data[k] * x[s->indices[k]];
+		}
+		y[i] = sum;
+	}
+}
+
+static void destroySplit(struct Operator* A){
+	struct SplitState* s = (struct SplitState*)A->state;
+	freeLarge(s->diag);
+	destroyMatrix(s->data, s->indices, s->length);
+	free(s);
+}
+
+/* Create an operator which keeps the diagonal of the ELLPACK-R
+ * matrix as a dense array and only the off-diagonal entries in
+ * ELLPACK-R format. Rows without a diagonal entry get a zero. The
+ * arrays are copied. */
+struct Operator* createSplitOperator(const int n, const offsetType nnz, const int maxNNZ, const floatType* data, const int* indices, const int* length){
+	struct Operator* A;
+	struct SplitState* s;
+	int i, j, l, offNNZ;
+	offsetType k;
+
+	A = (struct Operator*)malloc(sizeof(struct Operator));
+	s = (struct SplitState*)malloc(sizeof(struct SplitState));
+	if (A == NULL || s == NULL) {
+		puts("Out of memory!");
+		fatalError();
+	}
+
+	s->diag = (floatType*)allocLarge(sizeof(floatType) * n);
+	s->length = (int*)allocLarge(sizeof(int) * n);
+
+	/* Separate the diagonal */
+	offNNZ = 0;
+#pragma omp parallel for num_threads(threads) private(i, j, k) reduction(max:offNNZ)
+	for (i = 0; i < n; i++) {
+		s->diag[i] = 0.0;
+		s->length[i] = 0;
+		for (j = 0; j < length[i]; j++) {
+			k = (offsetType)j * n + i;
+			if (indices[k] == i)
+				s->diag[i] += data[k];
+			else
+				s->length[i]++;
+		}
+		if (s->length[i] > offNNZ)
+			offNNZ = s->length[i];
+	}
+	s->maxNNZ = offNNZ;
+
+	/* Shift the off-diagonal entries to the left, with the same
+	 * partition of the rows as in applySplit() */
+	s->data = (floatType*)allocLarge(sizeof(floatType) * ((size_t)s->maxNNZ * n + 1));
+	s->indices = (int*)allocLarge(sizeof(int) * ((size_t)s->maxNNZ * n + 1));
+#pragma omp parallel for num_threads(threads) private(i, j, k, l)
+	for (i = 0; i < n; i++) {
+		l = 0;
+		for (j = 0; j < length[i]; j++) {
+			k = (offsetType)j * n + i;
+			if (indices[k] != i) {
+				s->data[(offsetType)l * n + i] = data[k];
+				s->indices[(offsetType)l * n + i] = indices[k];
+				l++;
+			}
+		}
+		for (; l < s->maxNNZ; l++) {
+			s->data[(offsetType)l * n + i] = 0.0;
+			s->indices[(offsetType)l * n + i] = 0;
+		}
+	}
+
+	snprintf(A->format, sizeof(A->format), "diagonal + ELLPACK-R");
+	A->n = n;
+	A->nnz = nnz;
+	A->diag = s->diag;
+	A->apply = applySplit;
+	A->destroy = destroySplit;
+	A->state = s;
+	return A;
+}
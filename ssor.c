@@ -0,0 +1,234 @@
+/*****************************************************
+ * CG Solver (HPC Software Lab)
+ *
+ * Parallel Programming Models for Applications in the 
+ * Area of High-Performance Computation
+ *====================================================
+ * Multicolor SSOR preconditioner
+ *****************************************************/
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ssor.h"
+#include "precond.h"
+#include "alloc.h"
+#include "steal.h"
+
+/* Symmetric SOR on the ELLPACK-R matrix, which is only referenced.
+ * The rows are ordered by the colors of a graph coloring, the rows
+ * of color c are rows[colorStart[c]] to rows[colorStart[c+1]-1].
+ * Rows of the same color are not coupled, so they can be relaxed
+ * in parallel without changing the result. With CG_SCHEDULE=steal
+ * steal[c] distributes the rows of color c. */
+struct SSORState {
+	int colors;
+	int* colorStart;
+	int* rows;
+	struct StealSchedule** steal;
+	floatType* invDiag;
+	floatType omega;
+	const floatType* data;
+	const int* indices;
+	const int* length;
+};
+
+/* Relax row i:
+ * z_i <- z_i + omega * (r_i - sum_j a_ij * z_j) / a_ii */
+static inline void relaxRow(const struct SSORState* s, const int n, const floatType* r, floatType* z, const int i){
+	floatType sum = r[i];
+	offsetType k;
+	int j;
+
+	for (j = 0; j < s->length[i]; j++) {
+		k = (offsetType)j * n + i;
+		sum -= s->data[k] * z[s->indices[k]];
+	}
+	z[i] += s->omega * sum * s->invDiag[i];
+}
+
+/* Relax the rows of color c */
+#define RELAX_COLOR(c) \
+	do { \
+		_Pragma("omp for") \
+		for (t = s->colorStart[c]; t < s->colorStart[(c) + 1]; t++) \
+			relaxRow(s, n, r, z, s->rows[t]); \
+	} while (0)
+
+/* Arguments of relaxChunk() */
+struct RelaxChunk {
+	const struct SSORState* s;
+	int n;
+	const floatType* r;
+	floatType* z;
+	const int* rows;
+};
+
+/* Relax the rows rows[first] ... rows[last-1] of one color, a chunk
+ * of stealLoop() */
+static void relaxChunk(void* arg, const int first, const int last){
+	const struct RelaxChunk* a = (const struct RelaxChunk*)arg;
+	int t;
+
+	for (t = first; t < last; t++)
+		relaxRow(a->s, a->n, a->r, a->z, a->rows[t]);
+}
+
+/* Relax the rows of color c with the work-stealing schedule */
+#define STEAL_COLOR(c) \
+	do { \
+		arg.rows = s->rows + s->colorStart[c]; \
+		stealLoop(s->steal[c], relaxChunk, &arg); \
+	} while (0)
+
+/* z <- M^-1 * r with one forward sweep over the colors, starting
+ * from z = 0, and one backward sweep. The backward sweep makes M
+ * symmetric, as cg() requires it. All sweeps run in one parallel
+ * region, the colors are separated by the barriers of omp for. */
+static void applySSOR(const struct Preconditioner* M, const floatType* r, floatType* z){
+	const struct SSORState* s = (const struct SSORState*)M->state;
+	const int n = M->n;
+	int c, t, i;
+
+#pragma omp parallel num_threads(threads) private(c, t, i)
+	{
+		struct RelaxChunk arg = {s, n, r, z, NULL};
+
+#pragma omp for
+		for (i = 0; i < n; i++) {
+			z[i] = 0.0;
+		}
+		if (s->steal != NULL) {
+			for (c = 0; c < s->colors; c++)
+				STEAL_COLOR(c);
+			for (c = s->colors - 1; c >= 0; c--)
+				STEAL_COLOR(c);
+		} else {
+			for (c = 0; c < s->colors; c++)
+				RELAX_COLOR(c);
+			for (c = s->colors - 1; c >= 0; c--)
+				RELAX_COLOR(c);
+		}
+	}
+}
+
+static void destroySSOR(struct Preconditioner* M){
+	struct SSORState* s = (struct SSORState*)M->state;
+	int c;
+
+	if (s->steal != NULL) {
+		for (c = 0; c < s->colors; c++)
+			destroyStealSchedule(s->steal[c]);
+		free(s->steal);
+	}
+	free(s->colorStart);
+	freeLarge(s->rows);
+	freeLarge(s->invDiag);
+	free(s);
+}
+
+/* Color the rows greedily in their order: every row gets the
+ * smallest color none of its neighbors has yet. This needs at most
+ * maxNNZ + 1 colors. color[i] is set for every row, the number of
+ * colors is returned. */
+static int colorRows(const int n, const int maxNNZ, const int* indices, const int* length, int* color){
+	int* used;
+	int i, j, c, colors = 0;
+
+	used = (int*)malloc(sizeof(int) * (maxNNZ + 2));
+	if (used == NULL) {
+		puts("Out of memory!");
+		fatalError();
+	}
+	for (c = 0; c < maxNNZ + 2; c++)
+		used[c] = -1;
+
+	for (i = 0; i < n; i++) {
+		/* Mark the colors of the neighbors colored before */
+		for (j = 0; j < length[i]; j++) {
+			c = indices[(offsetType)j * n + i];
+			if (c < i)
+				used[color[c]] = i;
+		}
+		for (c = 0; used[c] == i; c++)
+			;
+		color[i] = c;
+		if (c >= colors)
+			colors = c + 1;
+	}
+
+	free(used);
+	return colors;
+}
+
+/* Create the SSOR preconditioner with relaxation factor omega for
+ * the ELLPACK-R matrix. The coloring is computed here once, the
+ * matrix arrays are not copied. */
+struct Preconditioner* createSSORPreconditioner(const int n, const int maxNNZ, const floatType* data, const int* indices, const int* length, const floatType omega){
+	struct Preconditioner* M;
+	struct SSORState* s;
+	int* color;
+	int i, c;
+
+	M = (struct Preconditioner*)malloc(sizeof(struct Preconditioner));
+	s = (struct SSORState*)malloc(sizeof(struct SSORState));
+	color = (int*)malloc(sizeof(int) * n);
+	if (M == NULL || s == NULL || color == NULL) {
+		puts("Out of memory!");
+		fatalError();
+	}
+
+	s->colors = colorRows(n, maxNNZ, indices, length, color);
+
+	/* Sort the rows by color with a counting sort, which keeps
+	 * the rows of one color in ascending order */
+	s->colorStart = (int*)calloc(s->colors + 1, sizeof(int));
+	if (s->colorStart == NULL) {
+		puts("Out of memory!");
+		fatalError();
+	}
+	for (i = 0; i < n; i++)
+		s->colorStart[color[i] + 1]++;
+	for (c = 0; c < s->colors; c++)
+		s->colorStart[c + 1] += s->colorStart[c];
+	s->rows = (int*)allocLarge(sizeof(int) * n);
+	for (i = 0; i < n; i++)
+		s->rows[s->colorStart[color[i]]++] = i;
+	for (c = s->colors; c > 0; c--)
+		s->colorStart[c] = s->colorStart[c - 1];
+	s->colorStart[0] = 0;
+	free(color);
+
+	s->invDiag = (floatType*)allocLarge(sizeof(floatType) * n);
+	extractDiagonal(n, data, indices, length, s->invDiag);
+#pragma omp parallel for num_threads(threads) private(i)
+	for (i = 0; i < n; i++) {
+		s->invDiag[i] = 1.0 / s->invDiag[i];
+	}
+
+	/* Every color gets a schedule of its own */
+	s->steal = NULL;
+	if (config.schedule == SCHEDULE_STEAL) {
+		s->steal = (struct StealSchedule**)malloc(sizeof(struct StealSchedule*) * s->colors);
+		if (s->steal == NULL) {
+			puts("Out of memory!");
+			fatalError();
+		}
+		for (c = 0; c < s->colors; c++)
+			s->steal[c] = createStealSchedule(s->colorStart[c + 1] - s->colorStart[c], s->rows + s->colorStart[c], length);
+	}
+
+	s->omega = omega;
+	s->data = data;
+	s->indices = indices;
+	s->length = length;
+
+	snprintf(M->name, sizeof(M->name), "SSOR, omega %.2f, %d colors", omega, s->colors);
+	M->n = n;
+	M->apply = applySSOR;
+	M->destroy = destroySSOR;
+	M->state = s;
+	return M;
+}
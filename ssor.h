@@ -0,0 +1,25 @@
+/*****************************************************
+ * CG Solver (HPC Software Lab)
+ *
+ * Parallel Programming Models for Applications in the 
+ * Area of High-Performance Computation
+ *====================================================
+ * Multicolor SSOR preconditioner
+ *****************************************************/
+
+
+#ifndef __SSOR_H__
+#define __SSOR_H__
+
+#include "def.h"
+#include "solver.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+struct Preconditioner* createSSORPreconditioner(const int n, const int maxNNZ, const floatType* data, const int* indices, const int* length, const floatType omega);
+#ifdef __cplusplus
+}
+#endif
+
+#endif
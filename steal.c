@@ -0,0 +1,199 @@
+/*****************************************************
+ * CG Solver (HPC Software Lab)
+ *
+ * Parallel Programming Models for Applications in the 
+ * Area of High-Performance Computation
+ *====================================================
+ * Work-stealing schedule for loops over rows
+ *****************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _OPENMP
+# include <omp.h>
+#else
+# define omp_get_thread_num() 0
+# define omp_get_num_threads() 1
+#endif
+
+#include "steal.h"
+#include "solver.h"
+#include "alloc.h"
+
+/* Time of every thread in the loops of all destroyed schedules, for
+ * stealReport(). Solvers of the library may be destroyed in several
+ * threads at once, so it is only used in the critical section
+ * "stealTimes". */
+static struct StealTime* stealTimes = NULL;
+static int stealThreads = 0;
+
+#define PACK(head, tail) (((unsigned long long)(head) << 32) | (unsigned int)(tail))
+#define HEAD(range) ((int)((range) >> 32))
+#define TAIL(range) ((int)((range) & 0xffffffffULL))
+
+/* Take the first chunk of the deque, -1 if it is empty */
+static int takeHead(struct StealQueue* q){
+	unsigned long long range = __atomic_load_n(&q->range, __ATOMIC_ACQUIRE);
+
+	do {
+		if (HEAD(range) >= TAIL(range))
+			return -1;
+	} while (!__atomic_compare_exchange_n(&q->range, &range, PACK(HEAD(range) + 1, TAIL(range)), 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+	return HEAD(range);
+}
+
+/* Steal the last chunk of the deque, -1 if it is empty */
+static int takeTail(struct StealQueue* q){
+	unsigned long long range = __atomic_load_n(&q->range, __ATOMIC_ACQUIRE);
+
+	do {
+		if (HEAD(range) >= TAIL(range))
+			return -1;
+	} while (!__atomic_compare_exchange_n(&q->range, &range, PACK(HEAD(range), TAIL(range) - 1), 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+	return TAIL(range) - 1;
+}
+
+/* Create a schedule for count items. Item i has length[rows[i]]
+ * nonzeros, or length[i] for rows = NULL. */
+struct StealSchedule* createStealSchedule(const int count, const int* rows, const int* length){
+	struct StealSchedule* S;
+	double total, sum;
+	int c, i, t;
+
+	S = (struct StealSchedule*)malloc(sizeof(struct StealSchedule));
+	if (S == NULL) {
+		puts("Out of memory!");
+		fatalError();
+	}
+	S->count = count;
+	S->threads = threads;
+	S->chunks = threads * STEAL_CHUNKS;
+	if (S->chunks > count)
+		S->chunks = (count > 0) ? count : 1;
+	S->start = (int*)malloc(sizeof(int) * (S->chunks + 1));
+	S->first = (int*)malloc(sizeof(int) * (S->threads + 1));
+	S->queues = (struct StealQueue*)allocAligned(sizeof(struct StealQueue) * S->threads);
+	S->times = (struct StealTime*)allocAligned(sizeof(struct StealTime) * S->threads);
+	if (S->start == NULL || S->first == NULL || S->queues == NULL || S->times == NULL) {
+		puts("Out of memory!");
+		fatalError();
+	}
+
+	/* Cut the items where the running sum of the nonzeros passes
+	 * a multiple of the chunk size. Every item also counts one
+	 * for the work per row. */
+	total = 0.0;
+	for (i = 0; i < count; i++)
+		total += (rows != NULL ? length[rows[i]] : length[i]) + 1;
+	S->start[0] = 0;
+	sum = 0.0;
+	c = 1;
+	for (i = 0; i < count && c < S->chunks; i++) {
+		sum += (rows != NULL ? length[rows[i]] : length[i]) + 1;
+		while (c < S->chunks && sum >= total * c / S->chunks)
+			S->start[c++] = i + 1;
+	}
+	while (c <= S->chunks)
+		S->start[c++] = count;
+
+	for (t = 0; t <= S->threads; t++)
+		S->first[t] = (int)((long long)t * S->chunks / S->threads);
+	for (t = 0; t < S->threads; t++)
+		S->queues[t].range = PACK(0, 0);
+	memset(S->times, 0, sizeof(struct StealTime) * S->threads);
+
+	return S;
+}
+
+/* Free the schedule and add its times to those for stealReport().
+ * If there is no memory for more threads, their times are lost. */
+void destroyStealSchedule(struct StealSchedule* S){
+	struct StealTime* grown;
+	int t;
+
+#pragma omp critical (stealTimes)
+	{
+		if (stealThreads < S->threads) {
+			grown = (struct StealTime*)realloc(stealTimes, sizeof(struct StealTime) * S->threads);
+			if (grown != NULL) {
+				memset(grown + stealThreads, 0, sizeof(struct StealTime) * (S->threads - stealThreads));
+				stealTimes = grown;
+				stealThreads = S->threads;
+			}
+		}
+		for (t = 0; t < S->threads && t < stealThreads; t++) {
+			stealTimes[t].busy += S->times[t].busy;
+			stealTimes[t].idle += S->times[t].idle;
+		}
+	}
+
+	free(S->start);
+	free(S->first);
+	freeAligned(S->queues);
+	freeAligned(S->times);
+	free(S);
+}
+
+/* Run body for all chunks of the schedule. It must be called by all
+ * threads of a parallel region and ends with a barrier. Every thread
+ * works on its own chunks in ascending order first, then it steals
+ * from the other threads, starting with the neighbors t+1, t-1, t+2,
+ * ..., as they work on the neighboring rows, on the same NUMA node. */
+void stealLoop(struct StealSchedule* S, StealBody body, void* arg){
+	const int t = omp_get_thread_num(), team = omp_get_num_threads();
+	double begin, done;
+	int c, d, v;
+
+	/* Refill the deques, also those of threads which are not part
+	 * of this region */
+	for (v = t; v < S->threads; v += team)
+		S->queues[v].range = PACK(S->first[v], S->first[v + 1]);
+#pragma omp barrier
+
+	begin = getWTime();
+	for (d = 0; d < S->threads; d++) {
+		v = (d % 2 == 1) ? t + (d + 1) / 2 : t - d / 2;
+		v = ((v % S->threads) + S->threads) % S->threads;
+		if (d == 0) {
+			while ((c = takeHead(&S->queues[v])) >= 0)
+				body(arg, S->start[c], S->start[c + 1]);
+		} else {
+			while ((c = takeTail(&S->queues[v])) >= 0)
+				body(arg, S->start[c], S->start[c + 1]);
+		}
+	}
+	done = getWTime();
+#pragma omp barrier
+
+	if (t < S->threads) {
+		S->times[t].busy += done - begin;
+		S->times[t].idle += getWTime() - done;
+	}
+}
+
+/* Run body for all chunks in a parallel region of its own */
+void stealFor(struct StealSchedule* S, StealBody body, void* arg){
+#pragma omp parallel num_threads(threads)
+	stealLoop(S, body, arg);
+}
+
+/* Print the busy and idle time of every thread in the loops of all
+ * destroyed schedules */
+void stealReport(void){
+	double busy = 0.0, idle = 0.0;
+	int t;
+
+#pragma omp critical (stealTimes)
+	if (stealTimes != NULL) {
+		printf("Work stealing, time per thread:\n");
+		for (t = 0; t < stealThreads; t++) {
+			printf("  Thread %3d: busy %f s, idle %f s\n", t, stealTimes[t].busy, stealTimes[t].idle);
+			busy += stealTimes[t].busy;
+			idle += stealTimes[t].idle;
+		}
+		if (busy + idle > 0.0)
+			printf("  Idle: %.1f%%\n", 100.0 * idle / (busy + idle));
+	}
+}
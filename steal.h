@@ -0,0 +1,70 @@
+/*****************************************************
+ * CG Solver (HPC Software Lab)
+ *
+ * Parallel Programming Models for Applications in the 
+ * Area of High-Performance Computation
+ *====================================================
+ * Work-stealing schedule for loops over rows
+ *****************************************************/
+
+
+
+
+#ifndef __STEAL_H__
+#define __STEAL_H__
+
+#include "def.h"
+
+/* Chunks per thread of a work-stealing schedule */
+#define STEAL_CHUNKS 16
+
+/* The deque of a thread: the chunks head ... tail-1 are left. The
+ * owner takes them from the head, other threads steal from the tail.
+ * Both ends are packed into range to update them with one atomic
+ * compare-and-swap. Every deque has its own cache line. */
+struct StealQueue {
+	unsigned long long range;
+	char pad[64 - sizeof(unsigned long long)];
+};
+
+/* Time, which a thread spent in scheduled loops working and waiting
+ * for the others at their end. Every thread has its own cache line. */
+struct StealTime {
+	double busy;
+	double idle;
+	char pad[64 - 2 * sizeof(double)];
+};
+
+/* A work-stealing schedule for a loop over count items, e.g. the
+ * rows of a matrix. The items are cut into chunks with about the
+ * same number of nonzeros, chunk c covers the items start[c] ...
+ * start[c+1]-1. Thread t starts with the consecutive chunks
+ * first[t] ... first[t+1]-1, the same rows a static schedule
+ * balanced by nonzeros would give it. times collects the time of
+ * every thread in the loops of this schedule. */
+struct StealSchedule {
+	int count;
+	int threads;
+	int chunks;
+	int* start;
+	int* first;
+	struct StealQueue* queues;
+	struct StealTime* times;
+};
+
+/* Body of a scheduled loop for the items first ... last-1 */
+typedef void (*StealBody)(void* arg, const int first, const int last);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+struct StealSchedule* createStealSchedule(const int count, const int* rows, const int* length);
+void destroyStealSchedule(struct StealSchedule* S);
+void stealLoop(struct StealSchedule* S, StealBody body, void* arg);
+void stealFor(struct StealSchedule* S, StealBody body, void* arg);
+void stealReport(void);
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,248 @@
+/*****************************************************
+ * CG Solver (HPC Software Lab)
+ *
+ * Parallel Programming Models for Applications in the 
+ * Area of High-Performance Computation
+ *====================================================
+ * Matrix-free stencil operator on structured grids
+ *****************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "stencil.h"
+#include "alloc.h"
+#include "io.h"
+
+/* Bytes of the grid lines of one tile, which should stay in the
+ * L2 cache while the planes of a tile are swept */
+#define STENCIL_TILE_BYTES (256 * 1024)
+
+/* The finite difference operator -div(k grad u) on a grid of
+ * nx * ny * nz points with zero Dirichlet boundaries and the point
+ * (i, j, l) at position (l * ny + j) * nx + i. For a constant k it
+ * is the 5 or 7 point Laplacian with center on the diagonal and
+ * -off next to it. Otherwise wx, wy and wz hold the weight of the
+ * face between a point and its neighbor in x, y and z direction,
+ * and diag the sum of the weights of all faces of a point. zero is
+ * a grid line of zeros which replaces the lines outside the grid.
+ * constantDiag holds center at every point for a constant k, so
+ * that the operator still exposes its diagonal.
+ * The lines are swept in tiles of tile lines in y direction. */
+struct StencilState {
+	int nx, ny, nz;
+	int tile;
+	floatType center, off;
+	floatType *diag, *wx, *wy, *wz;
+	floatType* constantDiag;
+	floatType* zero;
+};
+
+/* y <- A*x for the grid line j, l with the constant coefficients */
+static void constantLine(const struct StencilState* s, const floatType* x, floatType* y, const int j, const int l){
+	const int nx = s->nx;
+	const size_t plane = (size_t)nx * s->ny;
+	const size_t c = (size_t)l * plane + (size_t)j * nx;
+	const floatType* in = x + c;
+	const floatType* south = (j > 0) ? in - nx : s->zero;
+	const floatType* north = (j < s->ny - 1) ? in + nx : s->zero;
+	const floatType* below = (l > 0) ? in - plane : s->zero;
+	const floatType* above = (l < s->nz - 1) ? in + plane : s->zero;
+	const floatType center = s->center, off = s->off;
+	floatType* out = y + c;
+	int i;
+
+	if (nx == 1) {
+		out[0] = center * in[0] - off * (south[0] + north[0] + below[0] + above[0]);
+		return;
+	}
+
+	out[0] = center * in[0] - off * (in[1] + south[0] + north[0] + below[0] + above[0]);
+	for (i = 1; i < nx - 1; i++)
+		out[i] = center * in[i] - off * (in[i - 1] + in[i + 1] + south[i] + north[i] + below[i] + above[i]);
+	out[nx - 1] = center * in[nx - 1] - off * (in[nx - 2] + south[nx - 1] + north[nx - 1] + below[nx - 1] + above[nx - 1]);
+}
+
+/* y <- A*x for the grid line j, l with the variable coefficients.
+ * The weights of faces on the boundary are zero. */
+static void variableLine(const struct StencilState* s, const floatType* x, floatType* y, const int j, const int l){
+	const int nx = s->nx;
+	const size_t plane = (size_t)nx * s->ny;
+	const size_t c = (size_t)l * plane + (size_t)j * nx;
+	const floatType* in = x + c;
+	const floatType* south = (j > 0) ? in - nx : s->zero;
+	const floatType* north = (j < s->ny - 1) ? in + nx : s->zero;
+	const floatType* below = (l > 0) ? in - plane : s->zero;
+	const floatType* above = (l < s->nz - 1) ? in + plane : s->zero;
+	const floatType* d = s->diag + c;
+	const floatType* wx = s->wx + c;
+	const floatType* wn = s->wy + c;
+	const floatType* ws = (j > 0) ? s->wy + c - nx : s->zero;
+	const floatType* wa = s->wz + c;
+	const floatType* wb = (l > 0) ? s->wz + c - plane : s->zero;
+	floatType* out = y + c;
+	int i;
+
+	for (i = 0; i < nx; i++)
+		out[i] = d[i] * in[i] - ws[i] * south[i] - wn[i] * north[i] - wb[i] * below[i] - wa[i] * above[i];
+	for (i = 1; i < nx; i++)
+		out[i] -= wx[i - 1] * in[i - 1];
+	for (i = 0; i < nx - 1; i++)
+		out[i] -= wx[i] * in[i + 1];
+}
+
+/* y <- A*x tile by tile. Within a tile the planes are swept from
+ * bottom to top, so the lines of the planes below and above are
+ * still in the cache. */
+static void applyStencil(const struct Operator* A, const floatType* x, floatType* y){
+	const struct StencilState* s = (const struct StencilState*)A->state;
+	const int tiles = (s->ny + s->tile - 1) / s->tile;
+	int t, l, j, last;
+
+#pragma omp parallel for collapse(2) num_threads(threads) private(t, l, j, last)
+	for (t = 0; t < tiles; t++) {
+		for (l = 0; l < s->nz; l++) {
+			last = (t + 1) * s->tile < s->ny ? (t + 1) * s->tile : s->ny;
+			for (j = t * s->tile; j < last; j++) {
+				if (s->diag != NULL)
+					variableLine(s, x, y, j, l);
+				else
+					constantLine(s, x, y, j, l);
+			}
+		}
+	}
+}
+
+static void destroyStencil(struct Operator* A){
+	struct StencilState* s = (struct StencilState*)A->state;
+	if (s->diag != NULL) {
+		freeLarge(s->diag);
+		freeLarge(s->wx);
+		freeLarge(s->wy);
+		freeLarge(s->wz);
+	}
+	if (s->constantDiag != NULL)
+		freeLarge(s->constantDiag);
+	free(s->zero);
+	free(s);
+}
+
+/* Weight of the face between two points with the coefficients a
+ * and b (harmonic mean) */
+static floatType faceWeight(const floatType a, const floatType b){
+	return (a + b > 0.0) ? 2.0 * a * b / (a + b) : 0.0;
+}
+
+/* Compute the face weights and the diagonal from the coefficient k
+ * of every point. Faces on the boundary have the weight of the
+ * point. In 2D there are no faces in z direction. */
+static void stencilWeights(struct StencilState* s, const floatType* k){
+	const int nx = s->nx, ny = s->ny, nz = s->nz;
+	const size_t plane = (size_t)nx * ny;
+	size_t c;
+	int i, j, l;
+
+#pragma omp parallel for num_threads(threads) private(i, j, l, c)
+	for (l = 0; l < nz; l++) {
+		for (j = 0; j < ny; j++) {
+			for (i = 0; i < nx; i++) {
+				c = (size_t)l * plane + (size_t)j * nx + i;
+				s->wx[c] = (i < nx - 1) ? faceWeight(k[c], k[c + 1]) : 0.0;
+				s->wy[c] = (j < ny - 1) ? faceWeight(k[c], k[c + nx]) : 0.0;
+				s->wz[c] = (l < nz - 1) ? faceWeight(k[c], k[c + plane]) : 0.0;
+			}
+		}
+	}
+
+#pragma omp parallel for num_threads(threads) private(i, j, l, c)
+	for (l = 0; l < nz; l++) {
+		for (j = 0; j < ny; j++) {
+			for (i = 0; i < nx; i++) {
+				c = (size_t)l * plane + (size_t)j * nx + i;
+				s->diag[c] = ((i > 0) ? s->wx[c - 1] : k[c]) + ((i < nx - 1) ? s->wx[c] : k[c])
+				    + ((j > 0) ? s->wy[c - nx] : k[c]) + ((j < ny - 1) ? s->wy[c] : k[c]);
+				if (nz > 1)
+					s->diag[c] += ((l > 0) ? s->wz[c - plane] : k[c]) + ((l < nz - 1) ? s->wz[c] : k[c]);
+			}
+		}
+	}
+}
+
+/* Create the operator for the grid "NXxNY" (2D) or "NXxNYxNZ" (3D).
+ * The coefficients are constant, unless CG_STENCIL_COEFF names a
+ * file with the coefficient of every point (see readVector()). */
+struct Operator* createStencilOperator(const char* grid){
+	struct Operator* A;
+	struct StencilState* s;
+	floatType* k;
+	long long points, nnz, i;
+	char end;
+	int lines;
+
+	A = (struct Operator*)malloc(sizeof(struct Operator));
+	s = (struct StencilState*)malloc(sizeof(struct StencilState));
+	if (A == NULL || s == NULL) {
+		puts("Out of memory!");
+		fatalError();
+	}
+
+	s->nz = 1;
+	lines = sscanf(grid, "%dx%dx%d%c", &s->nx, &s->ny, &s->nz, &end);
+	if (lines < 2 || lines > 3 || s->nx < 1 || s->ny < 1 || s->nz < 1) {
+		printf("ERROR: Grid \"%s\" is not of the form NXxNY or NXxNYxNZ!\n", grid);
+		fatalError();
+	}
+	points = (long long)s->nx * s->ny * s->nz;
+	if (points > 2147483647LL) {
+		printf("ERROR: The grid %s has more than 2^31 points!\n", grid);
+		fatalError();
+	}
+
+	/* Lines of a tile, three planes of it should fit the cache */
+	s->tile = STENCIL_TILE_BYTES / (3 * sizeof(floatType) * s->nx);
+	if (s->tile < 1)
+		s->tile = 1;
+
+	s->zero = (floatType*)calloc(s->nx, sizeof(floatType));
+	if (s->zero == NULL) {
+		puts("Out of memory!");
+		fatalError();
+	}
+
+	s->center = (s->nz > 1) ? 6.0 : 4.0;
+	s->off = 1.0;
+	s->diag = s->wx = s->wy = s->wz = s->constantDiag = NULL;
+	if (config.stencilCoeff != NULL) {
+		k = (floatType*)allocLarge(sizeof(floatType) * points);
+		readVector(config.stencilCoeff, k, (int)points);
+		s->diag = (floatType*)allocLarge(sizeof(floatType) * points);
+		s->wx = (floatType*)allocLarge(sizeof(floatType) * points);
+		s->wy = (floatType*)allocLarge(sizeof(floatType) * points);
+		s->wz = (floatType*)allocLarge(sizeof(floatType) * points);
+		stencilWeights(s, k);
+		freeLarge(k);
+	} else {
+		s->constantDiag = (floatType*)allocLarge(sizeof(floatType) * points);
+#pragma omp parallel for num_threads(threads)
+		for (i = 0; i < points; i++)
+			s->constantDiag[i] = s->center;
+	}
+
+	/* The diagonal and two entries per inner face */
+	nnz = points + 2 * ((long long)(s->nx - 1) * s->ny * s->nz
+	    + (long long)s->nx * (s->ny - 1) * s->nz + (long long)s->nx * s->ny * (s->nz - 1));
+	if (nnz > OFFSET_MAX) {
+		printf("ERROR: Too many non zeros, rebuild with \"make large=1\"!\n");
+		fatalError();
+	}
+
+	A->n = (int)points;
+	A->nnz = (offsetType)nnz;
+	snprintf(A->format, sizeof(A->format), "%s stencil %s", (s->nz > 1) ? "7 point" : "5 point", s->diag != NULL ? "(variable)" : "(constant)");
+	A->diag = (s->diag != NULL) ? s->diag : s->constantDiag;
+	A->apply = applyStencil;
+	A->destroy = destroyStencil;
+	A->state = s;
+	return A;
+}
@@ -0,0 +1,28 @@
+/*****************************************************
+ * CG Solver (HPC Software Lab)
+ *
+ * Parallel Programming Models for Applications in the 
+ * Area of High-Performance Computation
+ *====================================================
+ * Matrix-free stencil operator on structured grids
+ *****************************************************/
+
+
+#ifndef __STENCIL_H__
+#define __STENCIL_H__
+
+#include "def.h"
+#include "solver.h"
+
+/* Prefix of the matrix argument which selects a stencil operator */
+#define STENCIL_PREFIX "stencil:"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+struct Operator* createStencilOperator(const char* grid);
+#ifdef __cplusplus
+}
+#endif
+
+#endif